@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QDBusError>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QTimer>
+
+#include "fakesystemd.h"
+
+static const QString connectionName = QStringLiteral("liri-session-bench-systemd");
+static const QString serviceName = QStringLiteral("org.freedesktop.systemd1");
+static const QString objectPath = QStringLiteral("/org/freedesktop/systemd1");
+static const QString interfaceName = QStringLiteral("org.freedesktop.systemd1.Manager");
+
+FakeSystemd::FakeSystemd(const QString &address, QObject *parent)
+    : QObject(parent)
+    , m_bus(QDBusConnection::connectToBus(address, connectionName))
+{
+    qDBusRegisterMetaType<SystemdProperty>();
+    qDBusRegisterMetaType<SystemdPropertyList>();
+    qDBusRegisterMetaType<SystemdAuxUnit>();
+    qDBusRegisterMetaType<SystemdAuxUnitList>();
+}
+
+FakeSystemd::~FakeSystemd()
+{
+    m_bus.unregisterObject(objectPath);
+    m_bus.unregisterService(serviceName);
+    QDBusConnection::disconnectFromBus(connectionName);
+}
+
+bool FakeSystemd::registerWithDBus()
+{
+    if (!m_bus.isConnected()) {
+        qWarning("Failed to connect to the private bus: %s",
+                 qPrintable(m_bus.lastError().message()));
+        return false;
+    }
+
+    if (!m_bus.registerService(serviceName)) {
+        qWarning("Failed to register D-Bus service \"%s\": %s",
+                 qPrintable(serviceName),
+                 qPrintable(m_bus.lastError().message()));
+        return false;
+    }
+
+    if (!m_bus.registerObject(objectPath, interfaceName, this,
+                              QDBusConnection::ExportAllSlots)) {
+        qWarning("Failed to register \"%s\" D-Bus interface: %s",
+                 qPrintable(interfaceName),
+                 qPrintable(m_bus.lastError().message()));
+        return false;
+    }
+
+    return true;
+}
+
+void FakeSystemd::Subscribe()
+{
+    // Signals are always broadcast
+}
+
+QDBusObjectPath FakeSystemd::StartTransientUnit(const QString &name, const QString &mode,
+                                                const SystemdPropertyList &properties,
+                                                const SystemdAuxUnitList &aux)
+{
+    Q_UNUSED(mode)
+    Q_UNUSED(properties)
+    Q_UNUSED(aux)
+
+    const uint id = ++m_lastJobId;
+    const QDBusObjectPath job(QStringLiteral("/org/freedesktop/systemd1/job/%1").arg(id));
+
+    // Like systemd, the job is removed after the reply is sent
+    QTimer::singleShot(0, this, [this, id, job, name] {
+        removeJob(id, job, name);
+    });
+
+    return job;
+}
+
+void FakeSystemd::removeJob(uint id, const QDBusObjectPath &job, const QString &unit)
+{
+    auto msg = QDBusMessage::createSignal(objectPath, interfaceName,
+                                          QStringLiteral("JobRemoved"));
+    msg << id << QVariant::fromValue(job) << unit << QStringLiteral("done");
+    m_bus.send(msg);
+}
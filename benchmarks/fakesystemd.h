@@ -0,0 +1,44 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef FAKESYSTEMD_H
+#define FAKESYSTEMD_H
+
+#include <QDBusConnection>
+#include <QDBusObjectPath>
+#include <QObject>
+
+#include "systemdmanager.h"
+
+/*
+ * Implements just enough of the systemd manager interface to let
+ * the launcher create transient scopes on a private bus.
+ *
+ * Jobs complete as soon as they are queued, so the latency measured
+ * on this path is our own overhead plus the D-Bus round trips.
+ */
+class FakeSystemd : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.systemd1.Manager")
+public:
+    explicit FakeSystemd(const QString &address, QObject *parent = nullptr);
+    ~FakeSystemd();
+
+    bool registerWithDBus();
+
+public Q_SLOTS:
+    void Subscribe();
+    QDBusObjectPath StartTransientUnit(const QString &name, const QString &mode,
+                                       const SystemdPropertyList &properties,
+                                       const SystemdAuxUnitList &aux);
+
+private:
+    QDBusConnection m_bus;
+    uint m_lastJobId = 0;
+
+    void removeJob(uint id, const QDBusObjectPath &job, const QString &unit);
+};
+
+#endif // FAKESYSTEMD_H
@@ -0,0 +1,362 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QDBusError>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QProcess>
+#include <QScopedPointer>
+#include <QSocketNotifier>
+#include <QTextStream>
+#include <QTimer>
+
+#include <algorithm>
+
+#include "fakesystemd.h"
+#include "launcherbench.h"
+#include "session.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const QString clientConnectionName = QStringLiteral("liri-session-bench-client");
+static const QString launcherService = QStringLiteral("io.liri.Launcher");
+static const QString launcherPath = QStringLiteral("/io/liri/Launcher");
+static const QString launcherInterface = QStringLiteral("io.liri.Launcher");
+
+static const QString stubAppId = QStringLiteral("io.liri.BenchStub");
+static const QString stubProgram = QStringLiteral("liri-session-bench-stub");
+
+// Time to wait for a single launch before giving up, in milliseconds
+static const int launchTimeout = 5000;
+
+static qint64 percentile(const QVector<qint64> &sorted, int p)
+{
+    if (sorted.isEmpty())
+        return 0;
+
+    // Nearest rank
+    const int rank = static_cast<int>((static_cast<qint64>(p) * sorted.size() + 99) / 100);
+    return sorted.at(qBound(1, rank, int(sorted.size())) - 1);
+}
+
+LauncherBench::LauncherBench(QObject *parent)
+    : QObject(parent)
+    , m_client(clientConnectionName)
+{
+}
+
+LauncherBench::~LauncherBench()
+{
+    QDBusConnection::disconnectFromBus(clientConnectionName);
+
+    if (m_dbusDaemon) {
+        m_dbusDaemon->terminate();
+        if (!m_dbusDaemon->waitForFinished(1000))
+            m_dbusDaemon->kill();
+    }
+
+    if (m_fifoNotifier)
+        m_fifoNotifier->setEnabled(false);
+    if (m_fifoFd >= 0)
+        ::close(m_fifoFd);
+    if (m_fifoWriteFd >= 0)
+        ::close(m_fifoWriteFd);
+}
+
+bool LauncherBench::setup()
+{
+    if (!m_dir.isValid()) {
+        qWarning("Failed to create temporary directory: %s",
+                 qPrintable(m_dir.errorString()));
+        return false;
+    }
+
+    // The bus address is read by the session only when it
+    // connects for the first time, that is after this
+    return setupEnvironment() && setupFifo() && setupStubs() && startBus();
+}
+
+QVector<LaunchResult> LauncherBench::run(bool systemd, int iterations, int warmup)
+{
+    QVector<LaunchResult> results;
+
+    const QString mode = systemd ? QStringLiteral("systemd") : QStringLiteral("direct");
+
+    QScopedPointer<FakeSystemd> fakeSystemd;
+    if (systemd) {
+        fakeSystemd.reset(new FakeSystemd(m_address));
+        if (!fakeSystemd->registerWithDBus())
+            return results;
+    }
+
+    // The same code path of the session manager, except
+    // that modules are not started
+    Session session;
+    session.setSystemdEnabled(systemd);
+    if (!session.initialize())
+        return results;
+
+    auto launchApplication = QDBusMessage::createMethodCall(
+                launcherService, launcherPath, launcherInterface,
+                QStringLiteral("LaunchApplication"));
+    launchApplication << stubAppId;
+    results.append(measure(mode, launchApplication, iterations, warmup));
+
+    const QString desktopFileName =
+            m_dir.filePath(QStringLiteral("data/applications/%1.desktop").arg(stubAppId));
+    auto launchDesktopFile = QDBusMessage::createMethodCall(
+                launcherService, launcherPath, launcherInterface,
+                QStringLiteral("LaunchDesktopFile"));
+    launchDesktopFile << desktopFileName;
+    results.append(measure(mode, launchDesktopFile, iterations, warmup));
+
+    auto launchCommand = QDBusMessage::createMethodCall(
+                launcherService, launcherPath, launcherInterface,
+                QStringLiteral("LaunchCommand"));
+    launchCommand << stubProgram;
+    results.append(measure(mode, launchCommand, iterations, warmup));
+
+    return results;
+}
+
+void LauncherBench::printResults(const QVector<LaunchResult> &results)
+{
+    QTextStream out(stdout);
+
+    out << QStringLiteral("%1 %2 %3 %4 %5 %6 %7 %8\n")
+           .arg(QStringLiteral("mode"), -8)
+           .arg(QStringLiteral("method"), -18)
+           .arg(QStringLiteral("runs"), 6)
+           .arg(QStringLiteral("failed"), 6)
+           .arg(QStringLiteral("p50 ms"), 9)
+           .arg(QStringLiteral("p95 ms"), 9)
+           .arg(QStringLiteral("p99 ms"), 9)
+           .arg(QStringLiteral("launches/s"), 11);
+
+    for (const auto &result : results) {
+        auto latencies = result.latencies;
+        std::sort(latencies.begin(), latencies.end());
+
+        const int runs = int(latencies.size()) + result.failures;
+        const double launchesPerSecond = result.elapsed > 0
+                ? latencies.size() * 1e9 / result.elapsed : 0.0;
+
+        out << QStringLiteral("%1 %2 %3 %4 %5 %6 %7 %8\n")
+               .arg(result.mode, -8)
+               .arg(result.method, -18)
+               .arg(runs, 6)
+               .arg(result.failures, 6)
+               .arg(percentile(latencies, 50) / 1e6, 9, 'f', 3)
+               .arg(percentile(latencies, 95) / 1e6, 9, 'f', 3)
+               .arg(percentile(latencies, 99) / 1e6, 9, 'f', 3)
+               .arg(launchesPerSecond, 11, 'f', 1);
+    }
+}
+
+bool LauncherBench::setupEnvironment()
+{
+    // Isolate the benchmark from the applications and
+    // caches of the user running it
+    const QStringList dirs = {
+        QStringLiteral("bin"),
+        QStringLiteral("cache"),
+        QStringLiteral("config"),
+        QStringLiteral("data/applications"),
+        QStringLiteral("data-dirs"),
+    };
+    for (const auto &dir : dirs) {
+        if (!QDir().mkpath(m_dir.filePath(dir))) {
+            qWarning("Failed to create \"%s\"", qPrintable(m_dir.filePath(dir)));
+            return false;
+        }
+    }
+
+    qputenv("XDG_DATA_HOME", QFile::encodeName(m_dir.filePath(QStringLiteral("data"))));
+    qputenv("XDG_DATA_DIRS", QFile::encodeName(m_dir.filePath(QStringLiteral("data-dirs"))));
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(m_dir.filePath(QStringLiteral("cache"))));
+    qputenv("XDG_CONFIG_HOME", QFile::encodeName(m_dir.filePath(QStringLiteral("config"))));
+    qputenv("XDG_CURRENT_DESKTOP", "X-Liri");
+
+    QByteArray path = QFile::encodeName(m_dir.filePath(QStringLiteral("bin")));
+    path.append(':');
+    path.append(qgetenv("PATH"));
+    qputenv("PATH", path);
+
+    return true;
+}
+
+bool LauncherBench::setupFifo()
+{
+    m_fifoPath = m_dir.filePath(QStringLiteral("launched"));
+    const QByteArray fifoPath = QFile::encodeName(m_fifoPath);
+
+    if (::mkfifo(fifoPath.constData(), 0600) < 0) {
+        qWarning("Failed to create FIFO: %s", strerror(errno));
+        return false;
+    }
+
+    // We keep the write end open too, otherwise every stub
+    // that quits would leave the FIFO at end of file
+    m_fifoFd = ::open(fifoPath.constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (m_fifoFd >= 0)
+        m_fifoWriteFd = ::open(fifoPath.constData(), O_WRONLY | O_CLOEXEC);
+    if (m_fifoFd < 0 || m_fifoWriteFd < 0) {
+        qWarning("Failed to open FIFO: %s", strerror(errno));
+        return false;
+    }
+
+    m_fifoNotifier = new QSocketNotifier(m_fifoFd, QSocketNotifier::Read, this);
+
+    return true;
+}
+
+bool LauncherBench::setupStubs()
+{
+    // The smallest program that tells us it's running
+    QFile stub(m_dir.filePath(QStringLiteral("bin/%1").arg(stubProgram)));
+    if (!stub.open(QFile::WriteOnly)) {
+        qWarning("Failed to write \"%s\": %s",
+                 qPrintable(stub.fileName()), qPrintable(stub.errorString()));
+        return false;
+    }
+    stub.write("#!/bin/sh\nprintf x > '");
+    stub.write(QFile::encodeName(m_fifoPath));
+    stub.write("'\n");
+    stub.close();
+    stub.setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    QFile desktopFile(m_dir.filePath(QStringLiteral("data/applications/%1.desktop").arg(stubAppId)));
+    if (!desktopFile.open(QFile::WriteOnly)) {
+        qWarning("Failed to write \"%s\": %s",
+                 qPrintable(desktopFile.fileName()), qPrintable(desktopFile.errorString()));
+        return false;
+    }
+    desktopFile.write("[Desktop Entry]\n"
+                      "Type=Application\n"
+                      "Name=Benchmark Stub\n"
+                      "Exec=");
+    desktopFile.write(stubProgram.toUtf8());
+    desktopFile.write(" %U\n");
+    desktopFile.close();
+
+    return true;
+}
+
+bool LauncherBench::startBus()
+{
+    m_dbusDaemon = new QProcess(this);
+    m_dbusDaemon->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    m_dbusDaemon->start(QStringLiteral("dbus-daemon"),
+                        QStringList() << QStringLiteral("--session")
+                                      << QStringLiteral("--print-address")
+                                      << QStringLiteral("--nofork"));
+    if (!m_dbusDaemon->waitForStarted()) {
+        qWarning("Failed to start dbus-daemon: %s",
+                 qPrintable(m_dbusDaemon->errorString()));
+        return false;
+    }
+
+    while (!m_dbusDaemon->canReadLine()) {
+        if (!m_dbusDaemon->waitForReadyRead(launchTimeout)) {
+            qWarning("Failed to read the private bus address");
+            return false;
+        }
+    }
+
+    m_address = QString::fromLocal8Bit(m_dbusDaemon->readLine().trimmed());
+    qputenv("DBUS_SESSION_BUS_ADDRESS", m_address.toLocal8Bit());
+
+    m_client = QDBusConnection::connectToBus(m_address, clientConnectionName);
+    if (!m_client.isConnected()) {
+        qWarning("Failed to connect to the private bus: %s",
+                 qPrintable(m_client.lastError().message()));
+        return false;
+    }
+
+    return true;
+}
+
+LaunchResult LauncherBench::measure(const QString &mode, const QDBusMessage &message,
+                                    int iterations, int warmup)
+{
+    LaunchResult result;
+    result.mode = mode;
+    result.method = message.member();
+
+    // The first launches also pay for populating caches
+    for (int i = 0; i < warmup; ++i) {
+        qint64 latency = 0;
+        launch(message, &latency);
+    }
+
+    QElapsedTimer elapsedTimer;
+    elapsedTimer.start();
+
+    for (int i = 0; i < iterations; ++i) {
+        qint64 latency = 0;
+        if (launch(message, &latency))
+            result.latencies.append(latency);
+        else
+            result.failures++;
+    }
+
+    result.elapsed = elapsedTimer.nsecsElapsed();
+
+    return result;
+}
+
+bool LauncherBench::launch(const QDBusMessage &message, qint64 *latency)
+{
+    QEventLoop loop;
+    bool launched = false;
+
+    QTimer::singleShot(launchTimeout, &loop, &QEventLoop::quit);
+
+    connect(m_fifoNotifier, &QSocketNotifier::activated, &loop, [this, &loop, &launched] {
+        if (readFifo()) {
+            launched = true;
+            loop.quit();
+        }
+    });
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QDBusPendingCallWatcher watcher(m_client.asyncCall(message));
+    connect(&watcher, &QDBusPendingCallWatcher::finished, &loop, [&loop](QDBusPendingCallWatcher *self) {
+        // Nothing is going to be launched
+        QDBusPendingReply<bool> reply = *self;
+        if (reply.isError()) {
+            qWarning("Launch failed: %s", qPrintable(reply.error().message()));
+            loop.quit();
+        } else if (!reply.value()) {
+            loop.quit();
+        }
+    });
+
+    loop.exec();
+
+    *latency = timer.nsecsElapsed();
+
+    return launched;
+}
+
+bool LauncherBench::readFifo()
+{
+    char buffer[64];
+    ssize_t size;
+    do {
+        size = ::read(m_fifoFd, buffer, sizeof(buffer));
+    } while (size < 0 && errno == EINTR);
+
+    return size > 0;
+}
@@ -0,0 +1,69 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef LAUNCHERBENCH_H
+#define LAUNCHERBENCH_H
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QObject>
+#include <QTemporaryDir>
+#include <QVector>
+
+class QProcess;
+class QSocketNotifier;
+
+struct LaunchResult
+{
+    QString mode;
+    QString method;
+    // Latencies of successful launches, in nanoseconds
+    QVector<qint64> latencies;
+    int failures = 0;
+    qint64 elapsed = 0;
+};
+
+/*
+ * Measures how long it takes from a launcher D-Bus call to the
+ * launched program being up and running.
+ *
+ * Everything runs against a private bus and a temporary XDG
+ * environment: the launched program is a stub that writes one
+ * byte to a FIFO that we are watching.
+ */
+class LauncherBench : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LauncherBench(QObject *parent = nullptr);
+    ~LauncherBench();
+
+    bool setup();
+
+    QVector<LaunchResult> run(bool systemd, int iterations, int warmup);
+
+    static void printResults(const QVector<LaunchResult> &results);
+
+private:
+    QTemporaryDir m_dir;
+    QProcess *m_dbusDaemon = nullptr;
+    QString m_address;
+    QDBusConnection m_client;
+    QString m_fifoPath;
+    int m_fifoFd = -1;
+    int m_fifoWriteFd = -1;
+    QSocketNotifier *m_fifoNotifier = nullptr;
+
+    bool setupEnvironment();
+    bool setupFifo();
+    bool setupStubs();
+    bool startBus();
+
+    LaunchResult measure(const QString &mode, const QDBusMessage &message,
+                         int iterations, int warmup);
+    bool launch(const QDBusMessage &message, qint64 *latency);
+    bool readFifo();
+};
+
+#endif // LAUNCHERBENCH_H
@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+#include "launcherbench.h"
+
+#define TR(x) QT_TRANSLATE_NOOP("Command line parser", QStringLiteral(x))
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("Session Benchmark"));
+    app.setApplicationVersion(QStringLiteral(LIRI_SESSION_VERSION));
+    app.setOrganizationName(QStringLiteral("Liri"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(TR("Measure application launch latency"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+                                        TR("Number of launches for each method."),
+                                        TR("count"), QStringLiteral("200"));
+    parser.addOption(iterationsOption);
+
+    QCommandLineOption warmupOption(QStringLiteral("warmup"),
+                                    TR("Number of launches to discard for each method."),
+                                    TR("count"), QStringLiteral("5"));
+    parser.addOption(warmupOption);
+
+    parser.process(app);
+
+    bool ok = false;
+    const int iterations = parser.value(iterationsOption).toInt(&ok);
+    if (!ok || iterations <= 0) {
+        qWarning("Invalid number of iterations");
+        return 1;
+    }
+    const int warmup = parser.value(warmupOption).toInt(&ok);
+    if (!ok || warmup < 0) {
+        qWarning("Invalid number of warmup launches");
+        return 1;
+    }
+
+    LauncherBench bench;
+    if (!bench.setup())
+        return 1;
+
+    QVector<LaunchResult> results;
+    results += bench.run(false, iterations, warmup);
+    results += bench.run(true, iterations, warmup);
+    if (results.size() != 6) {
+        qWarning("Benchmark failed");
+        return 1;
+    }
+
+    LauncherBench::printResults(results);
+
+    for (const auto &result : qAsConst(results)) {
+        if (result.failures > 0)
+            return 1;
+    }
+
+    return 0;
+}
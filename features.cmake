@@ -24,6 +24,9 @@ add_feature_info("Session::DevelopmentBuild" LIRI_SESSION_DEVELOPMENT_BUILD "Bui
 option(LIRI_ENABLE_SYSTEMD "Enable systemd support" ON)
 add_feature_info("Liri::Systemd" LIRI_ENABLE_SYSTEMD "Enable systemd support")
 
+option(LIRI_SESSION_BUILD_BENCHMARKS "Build benchmarks" OFF)
+add_feature_info("Session::Benchmarks" LIRI_SESSION_BUILD_BENCHMARKS "Build the launcher benchmark")
+
 ## Features summary:
 if(NOT LIRI_SUPERBUILD)
     feature_summary(WHAT ENABLED_FEATURES DISABLED_FEATURES)
@@ -25,11 +25,11 @@
 #include <QDBusConnection>
 #include <QDBusMessage>
 
+#include <libpluginregistry/pluginregistry.h>
 #include <libsigwatch/sigwatch.h>
 
 #include "daemon.h"
 #include "daemoninterface.h"
-#include "pluginregistry.h"
 
 Q_LOGGING_CATEGORY(lcDaemon, "liri.daemon", QtInfoMsg)
 
@@ -37,7 +37,11 @@ Q_GLOBAL_STATIC(Daemon, s_daemon)
 
 Daemon::Daemon(QObject *parent)
     : QObject(parent)
-    , m_pluginRegistry(new PluginRegistry(this))
+    , m_pluginRegistry(new PluginRegistry(
+                           QStringLiteral("DaemonModule"),
+                           QStringList({QStringLiteral(LiriDaemonModule_iid)}),
+                           QString::asprintf("%s/liri/daemon", PLUGINSDIR),
+                           this))
 {
     // Unix signals watcher
     UnixSignalWatcher *sigwatch = new UnixSignalWatcher(this);
@@ -84,35 +88,17 @@ bool Daemon::initialize()
     if (m_interface && !m_interface->registerWithDBus())
         return false;
 
-    // Discover plugins
+    // Discover plugins, they are instantiated only when loaded
     m_pluginRegistry->discover();
 
     // Add modules to the list
-    PluginsMap plugins = m_pluginRegistry->plugins();
-    PluginsMap::iterator it;
-    for (it = plugins.begin(); it != plugins.end(); ++it) {
-        auto name = it.key();
-        auto instance = it.value();
-        auto module = dynamic_cast<Liri::DaemonModule *>(instance);
-
-        if (!module) {
-            qCWarning(lcDaemon, "Plugin \"%s\" is not a daemon module",
-                      qPrintable(name));
-            continue;
-        }
-
-        // Remove the module when it is deleted
-        connect(module, &Liri::DaemonModule::moduleDeleted, this, [this, module] {
-            m_loadedModules.removeOne(module);
-            m_modules.removeOne(module);
-            m_modulesOnDemand.removeOne(module);
-        });
-
+    const auto names = m_pluginRegistry->pluginNames();
+    for (const auto &name : names) {
         auto metaData = m_pluginRegistry->getMetaData(name);
         if (metaData.value(QStringLiteral("X-Liri-DaemonModule-AutoLoad"), true).toBool())
-            m_modules.append(module);
+            m_modules.append(name);
         else
-            m_modulesOnDemand.append(module);
+            m_modulesOnDemand.append(name);
     }
 
     return true;
@@ -125,18 +111,15 @@ void Daemon::start()
         return;
 
     // Start all modules
-    for (auto *module : qAsConst(m_modules)) {
-        auto name = m_pluginRegistry->getNameForInstance(module);
-        if (!module) {
-            qCWarning(lcDaemon, "Ignoring invalid session module \"%s\"",
-                      qPrintable(name));
-            continue;
-        }
-
+    for (const auto &name : qAsConst(m_modules)) {
         // Skip disabled modules
         if (m_disabledModules.contains(name))
             continue;
 
+        auto *module = getModule(name);
+        if (!module)
+            continue;
+
         // Start
         qCInfo(lcDaemon, "==> Starting module \"%s\"", qPrintable(name));
         module->start();
@@ -152,14 +135,14 @@ void Daemon::shutdown()
     qCInfo(lcDaemon, "Stopping...");
 
     // Stop modules
-    std::reverse(m_loadedModules.begin(), m_loadedModules.end());
-    for (auto *module : qAsConst(m_loadedModules)) {
-        auto *instance = dynamic_cast<QObject *>(module);
-        const auto name = m_pluginRegistry->getNameForInstance(instance);
-
-        // Stop
-        unloadModule(name);
+    ModulesList modules = m_loadedModules;
+    std::reverse(modules.begin(), modules.end());
+    for (auto *module : qAsConst(modules)) {
+        qCInfo(lcDaemon, "==> Stopping module \"%s\"",
+               qPrintable(m_pluginRegistry->getNameForInstance(module)));
+        module->stop();
     }
+    m_loadedModules.clear();
 
     qCInfo(lcDaemon, "Bye");
     QCoreApplication::quit();
@@ -172,16 +155,16 @@ void Daemon::loadModule(const QString &name)
         return;
 
     // Find module
-    auto *instance = m_pluginRegistry->getInstance(name);
-    auto *module = qobject_cast<Liri::DaemonModule *>(instance);
+    if (!m_modules.contains(name) && !m_modulesOnDemand.contains(name)) {
+        qCWarning(lcDaemon, "Cannot find module \"%s\"", qPrintable(name));
+        return;
+    }
+    auto *module = getModule(name);
+    if (!module)
+        return;
 
     // Load module
     if (!m_loadedModules.contains(module)) {
-        if (!m_modules.contains(module)) {
-            qCWarning(lcDaemon, "Cannot find module \"%s\"", qPrintable(name));
-            return;
-        }
-
         qCInfo(lcDaemon, "==> Starting module \"%s\"", qPrintable(name));
 
         // Claim a D-Bus service name so that systemd knows it started
@@ -208,12 +191,13 @@ void Daemon::unloadModule(const QString &name)
     if (isShuttingDown())
         return;
 
-    // Find module
-    auto *instance = m_pluginRegistry->getInstance(name);
-    auto *module = qobject_cast<Liri::DaemonModule *>(instance);
+    // Find module, there is nothing to do if it was never instantiated
+    if (!m_pluginRegistry->isInstantiated(name))
+        return;
+    auto *module = getModule(name);
 
     // Unload module
-    if (m_loadedModules.contains(module)) {
+    if (module && m_loadedModules.contains(module)) {
         qCInfo(lcDaemon, "==> Stopping module \"%s\"", qPrintable(name));
 
         module->stop();
@@ -227,6 +211,28 @@ void Daemon::unloadModule(const QString &name)
     }
 }
 
+Liri::DaemonModule *Daemon::getModule(const QString &name)
+{
+    const bool instantiated = m_pluginRegistry->isInstantiated(name);
+
+    auto *instance = m_pluginRegistry->getInstance(name);
+    auto *module = qobject_cast<Liri::DaemonModule *>(instance);
+    if (!module) {
+        qCWarning(lcDaemon, "Plugin \"%s\" is not a daemon module",
+                  qPrintable(name));
+        return nullptr;
+    }
+
+    // Remove the module when it is deleted
+    if (!instantiated) {
+        connect(module, &Liri::DaemonModule::moduleDeleted, this, [this, module] {
+            m_loadedModules.removeOne(module);
+        });
+    }
+
+    return module;
+}
+
 Daemon *Daemon::instance()
 {
     return s_daemon();
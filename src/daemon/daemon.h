@@ -68,10 +68,12 @@ private:
     bool m_running = true;
     QStringList m_disabledModules;
     PluginRegistry *m_pluginRegistry = nullptr;
-    ModulesList m_modules;
-    ModulesList m_modulesOnDemand;
+    QStringList m_modules;
+    QStringList m_modulesOnDemand;
     ModulesList m_loadedModules;
     DaemonInterface *m_interface = nullptr;
+
+    Liri::DaemonModule *getModule(const QString &name);
 };
 
 #endif // DAEMON_H
@@ -2,20 +2,62 @@
 //
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
+#include <QDBusArgument>
 #include <QDBusConnection>
 #include <QDBusError>
 #include <QDBusPendingCallWatcher>
 #include <QDBusPendingReply>
+#include <QDBusVariant>
 
 #include "qmllauncher.h"
 
 Q_LOGGING_CATEGORY(lcLauncher, "liri.session.launcher", QtInfoMsg)
 
+// Nested containers are demarshalled as QDBusArgument, which QML can't use
+static QVariant toQmlValue(const QVariant &value)
+{
+    if (value.userType() == qMetaTypeId<QDBusVariant>())
+        return toQmlValue(value.value<QDBusVariant>().variant());
+    if (value.userType() != qMetaTypeId<QDBusArgument>())
+        return value;
+
+    const auto argument = value.value<QDBusArgument>();
+    switch (argument.currentType()) {
+    case QDBusArgument::MapType: {
+        QVariantMap map;
+        argument.beginMap();
+        while (!argument.atEnd()) {
+            argument.beginMapEntry();
+            const auto key = argument.asVariant().toString();
+            map.insert(key, toQmlValue(argument.asVariant()));
+            argument.endMapEntry();
+        }
+        argument.endMap();
+        return map;
+    }
+    case QDBusArgument::ArrayType: {
+        QVariantList list;
+        argument.beginArray();
+        while (!argument.atEnd())
+            list.append(toQmlValue(argument.asVariant()));
+        argument.endArray();
+        return list;
+    }
+    default:
+        return value;
+    }
+}
+
 QmlLauncher::QmlLauncher(QObject *parent)
     : QObject(parent)
 {
 }
 
+QVariantMap QmlLauncher::launchStats() const
+{
+    return m_launchStats;
+}
+
 void QmlLauncher::launchApplication(const QString &appId)
 {
     auto msg = QDBusMessage::createMethodCall(
@@ -81,3 +123,43 @@ void QmlLauncher::launchCommand(const QString &command)
         self->deleteLater();
     });
 }
+
+void QmlLauncher::updateLaunchStats()
+{
+    auto msg = QDBusMessage::createMethodCall(
+                QStringLiteral("io.liri.Launcher"),
+                QStringLiteral("/io/liri/Launcher"),
+                QStringLiteral("io.liri.Launcher"),
+                QStringLiteral("GetLaunchStats"));
+    QDBusPendingCall call = QDBusConnection::sessionBus().asyncCall(msg);
+    auto *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *self) {
+        QDBusPendingReply<QVariantMap> reply = *self;
+        if (reply.isError()) {
+            qCWarning(lcLauncher, "Failed to get launch statistics: %s",
+                      qPrintable(reply.error().message()));
+        } else {
+            m_launchStats.clear();
+            const auto stats = reply.value();
+            for (auto it = stats.constBegin(); it != stats.constEnd(); ++it)
+                m_launchStats.insert(it.key(), toQmlValue(it.value()));
+            Q_EMIT launchStatsChanged();
+        }
+
+        self->deleteLater();
+    });
+}
+
+void QmlLauncher::reportFirstWindow(const QString &appId, uint pid)
+{
+    auto msg = QDBusMessage::createMethodCall(
+                QStringLiteral("io.liri.Launcher"),
+                QStringLiteral("/io/liri/Launcher"),
+                QStringLiteral("io.liri.Launcher"),
+                QStringLiteral("ReportFirstWindow"));
+    QVariantList args;
+    args.append(appId);
+    args.append(pid);
+    msg.setArguments(args);
+    QDBusConnection::sessionBus().send(msg);
+}
@@ -7,18 +7,31 @@
 
 #include <QObject>
 #include <QLoggingCategory>
+#include <QVariantMap>
 
 Q_DECLARE_LOGGING_CATEGORY(lcLauncher)
 
 class QmlLauncher : public QObject
 {
     Q_OBJECT
+    Q_PROPERTY(QVariantMap launchStats READ launchStats NOTIFY launchStatsChanged)
 public:
     QmlLauncher(QObject *parent = nullptr);
 
+    QVariantMap launchStats() const;
+
     Q_INVOKABLE void launchApplication(const QString &appId);
     Q_INVOKABLE void launchDesktopFile(const QString &fileName);
     Q_INVOKABLE void launchCommand(const QString &command);
+
+    Q_INVOKABLE void updateLaunchStats();
+    Q_INVOKABLE void reportFirstWindow(const QString &appId, uint pid);
+
+Q_SIGNALS:
+    void launchStatsChanged();
+
+private:
+    QVariantMap m_launchStats;
 };
 
 #endif // LIRI_QML_SESSION_LAUNCHER_H
@@ -31,6 +31,14 @@ QmlSessionManager::QmlSessionManager(QObject *parent)
                 QStringLiteral("io.liri.SessionManager"),
                 QStringLiteral("Unlocked"),
                 this, SIGNAL(sessionUnlocked()));
+
+    // The session manager decides when the session is idle
+    QDBusConnection::sessionBus().connect(
+                QStringLiteral("io.liri.SessionManager"),
+                QStringLiteral("/io/liri/SessionManager"),
+                QStringLiteral("io.liri.SessionManager"),
+                QStringLiteral("IdleChanged"),
+                this, SLOT(handleIdleChanged(bool)));
 }
 
 bool QmlSessionManager::isIdle() const
@@ -51,7 +59,7 @@ void QmlSessionManager::setIdle(bool value)
     msg.setArguments(QVariantList() << value);
     QDBusPendingCall call = QDBusConnection::sessionBus().asyncCall(msg);
     auto *watcher = new QDBusPendingCallWatcher(call, this);
-    connect(watcher, &QDBusPendingCallWatcher::finished, this, [&](QDBusPendingCallWatcher *self) {
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, value](QDBusPendingCallWatcher *self) {
         QDBusPendingReply<> reply = *self;
         if (reply.isError()) {
             qCWarning(lcSession, "Failed to toggle idle flag: %s",
@@ -127,3 +135,28 @@ void QmlSessionManager::setEnvironment(const QString &key, const QString &value)
         self->deleteLater();
     });
 }
+
+void QmlSessionManager::reportActivity()
+{
+    // Input events come in bursts, the idle delay is in seconds anyway,
+    // but waking up from idle must not wait
+    if (!m_idle && m_activityTimer.isValid() && m_activityTimer.elapsed() < 1000)
+        return;
+    m_activityTimer.start();
+
+    auto msg = QDBusMessage::createMethodCall(
+                QStringLiteral("io.liri.SessionManager"),
+                QStringLiteral("/io/liri/SessionManager"),
+                QStringLiteral("io.liri.SessionManager"),
+                QStringLiteral("ReportActivity"));
+    QDBusConnection::sessionBus().send(msg);
+}
+
+void QmlSessionManager::handleIdleChanged(bool idle)
+{
+    if (m_idle == idle)
+        return;
+
+    m_idle = idle;
+    emit idleChanged(m_idle);
+}
@@ -5,6 +5,7 @@
 #ifndef LIRI_QML_SESSION_SESSIONMANAGER_H
 #define LIRI_QML_SESSION_SESSIONMANAGER_H
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QLoggingCategory>
 
@@ -23,6 +24,7 @@ public:
     Q_INVOKABLE void lock();
     Q_INVOKABLE void unlock();
     Q_INVOKABLE void setEnvironment(const QString &key, const QString &value);
+    Q_INVOKABLE void reportActivity();
 
 Q_SIGNALS:
     void idleChanged(bool value);
@@ -33,6 +35,10 @@ Q_SIGNALS:
 
 private:
     bool m_idle = false;
+    QElapsedTimer m_activityTimer;
+
+private Q_SLOTS:
+    void handleIdleChanged(bool idle);
 };
 
 #endif // LIRI_QML_SESSION_SESSIONMANAGER_H
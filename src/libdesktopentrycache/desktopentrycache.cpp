@@ -0,0 +1,960 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QLocale>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+
+#include <algorithm>
+#include <string.h>
+
+#include "desktopentrycache.h"
+
+Q_LOGGING_CATEGORY(lcDesktopEntryCache, "liri.session.desktopentrycache", QtInfoMsg)
+
+/*
+ * The cache file is made of a header followed by arrays of fixed size
+ * records and a pool of NUL-terminated UTF-8 strings, records refer to
+ * strings by their offset in the pool; offset 0 is the empty string.
+ * Numbers are in host byte order, it's a cache after all.
+ */
+
+static const quint32 CacheMagic = 0x4c444543; // "LDEC"
+static const quint32 CacheVersion = 5;
+
+// Separates items of lists
+static const char ListSeparator = '\x1f';
+// Separates locale and value pairs of localized strings
+static const char LocaleSeparator = '\x1e';
+
+enum EntryKind : quint32 {
+    ApplicationEntry = 0,
+    AutostartEntry
+};
+
+enum Field {
+    IdField = 0,
+    FileNameField,
+    NameField,
+    GenericNameField,
+    CommentField,
+    IconField,
+    ExecField,
+    TryExecField,
+    PathField,
+    CategoriesField,
+    MimeTypeField,
+    OnlyShowInField,
+    NotShowInField,
+    LocalizedNameField,
+    LocalizedGenericNameField,
+    LocalizedCommentField,
+    AutostartDelayField,
+    AutostartPhaseField,
+    ResourceProfileField,
+    TypeField,
+    FieldCount
+};
+
+enum Flag : quint32 {
+    DBusActivatableFlag = 0x01,
+    HiddenFlag = 0x02,
+    NoDisplayFlag = 0x04,
+    TerminalFlag = 0x08,
+    HiddenUnderSystemdFlag = 0x10
+};
+
+struct CacheHeader
+{
+    quint32 magic;
+    quint32 version;
+    // Directories that were scanned, to detect a different environment
+    quint32 roots;
+    // Directories and files the cache was built from
+    quint32 sourceCount;
+    quint32 sourcesOffset;
+    quint32 entryCount;
+    // Records sorted by kind and ID
+    quint32 entriesOffset;
+    // Indexes of records sorted by kind and file name
+    quint32 fileNameIndexOffset;
+    quint32 stringsOffset;
+    quint32 stringsSize;
+};
+
+struct CacheSource
+{
+    quint32 path;
+    quint32 reserved;
+    qint64 lastModified;
+    qint64 size;
+};
+
+struct CacheRecord
+{
+    quint32 kind;
+    quint32 flags;
+    quint32 strings[FieldCount];
+};
+
+/*
+ * Parsing and writing
+ */
+
+struct ParsedEntry
+{
+    quint32 kind = ApplicationEntry;
+    quint32 flags = 0;
+    QByteArray fields[FieldCount];
+};
+
+static QByteArray unescapeValue(const QByteArray &value, bool list)
+{
+    QByteArray result;
+    result.reserve(value.size());
+
+    for (int i = 0; i < value.size(); ++i) {
+        const char c = value.at(i);
+        if (c == '\\' && i + 1 < value.size()) {
+            const char next = value.at(++i);
+            switch (next) {
+            case 's':
+                result.append(' ');
+                break;
+            case 'n':
+                result.append('\n');
+                break;
+            case 't':
+                result.append('\t');
+                break;
+            case 'r':
+                result.append('\r');
+                break;
+            case ';':
+                result.append(';');
+                break;
+            default:
+                result.append(next);
+                break;
+            }
+        } else if (list && c == ';') {
+            result.append(ListSeparator);
+        } else {
+            result.append(c);
+        }
+    }
+
+    // Lists usually end with a separator
+    if (list && result.endsWith(ListSeparator))
+        result.chop(1);
+
+    return result;
+}
+
+static bool parseDesktopFile(const QString &fileName, ParsedEntry &entry)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    static const QHash<QByteArray, int> stringKeys = {
+        { "Type", TypeField },
+        { "Name", NameField },
+        { "GenericName", GenericNameField },
+        { "Comment", CommentField },
+        { "Icon", IconField },
+        { "Exec", ExecField },
+        { "TryExec", TryExecField },
+        { "Path", PathField },
+        { "X-GNOME-Autostart-Delay", AutostartDelayField },
+        { "X-Liri-Autostart-Phase", AutostartPhaseField },
+        { "X-Liri-ResourceProfile", ResourceProfileField }
+    };
+    static const QHash<QByteArray, int> listKeys = {
+        { "Categories", CategoriesField },
+        { "MimeType", MimeTypeField },
+        { "OnlyShowIn", OnlyShowInField },
+        { "NotShowIn", NotShowInField }
+    };
+    static const QHash<QByteArray, int> localizedKeys = {
+        { "Name", LocalizedNameField },
+        { "GenericName", LocalizedGenericNameField },
+        { "Comment", LocalizedCommentField }
+    };
+    static const QHash<QByteArray, quint32> flagKeys = {
+        { "DBusActivatable", DBusActivatableFlag },
+        { "Hidden", HiddenFlag },
+        { "NoDisplay", NoDisplayFlag },
+        { "Terminal", TerminalFlag },
+        { "X-GNOME-HiddenUnderSystemd", HiddenUnderSystemdFlag }
+    };
+
+    bool inMainGroup = false;
+    bool hasMainGroup = false;
+
+    const auto lines = file.readAll().split('\n');
+    for (const auto &rawLine : lines) {
+        const auto line = rawLine.trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        if (line.startsWith('[')) {
+            inMainGroup = line == "[Desktop Entry]";
+            hasMainGroup = hasMainGroup || inMainGroup;
+            continue;
+        }
+        if (!inMainGroup)
+            continue;
+
+        const int index = line.indexOf('=');
+        if (index <= 0)
+            continue;
+        const auto key = line.left(index).trimmed();
+        const auto value = line.mid(index + 1).trimmed();
+
+        // Localized values are stored all together
+        const int bracket = key.indexOf('[');
+        if (bracket > 0 && key.endsWith(']')) {
+            const int field = localizedKeys.value(key.left(bracket), -1);
+            if (field >= 0) {
+                auto &localized = entry.fields[field];
+                if (!localized.isEmpty())
+                    localized.append(LocaleSeparator);
+                localized.append(key.mid(bracket + 1, key.size() - bracket - 2));
+                localized.append(ListSeparator);
+                localized.append(unescapeValue(value, false));
+            }
+            continue;
+        }
+
+        if (stringKeys.contains(key))
+            entry.fields[stringKeys.value(key)] = unescapeValue(value, false);
+        else if (listKeys.contains(key))
+            entry.fields[listKeys.value(key)] = unescapeValue(value, true);
+        else if (flagKeys.contains(key) && value == "true")
+            entry.flags |= flagKeys.value(key);
+    }
+
+    return hasMainGroup;
+}
+
+class CacheWriter
+{
+public:
+    CacheWriter()
+    {
+        // Offset 0 is the empty string
+        m_strings.append('\0');
+    }
+
+    quint32 addString(const QByteArray &string)
+    {
+        if (string.isEmpty())
+            return 0;
+
+        auto it = m_offsets.constFind(string);
+        if (it != m_offsets.constEnd())
+            return it.value();
+
+        const quint32 offset = m_strings.size();
+        m_strings.append(string);
+        m_strings.append('\0');
+        m_offsets.insert(string, offset);
+        return offset;
+    }
+
+    QByteArray strings() const
+    {
+        return m_strings;
+    }
+
+private:
+    QByteArray m_strings;
+    QHash<QByteArray, quint32> m_offsets;
+};
+
+static quint32 align(quint32 offset)
+{
+    return (offset + 7) & ~quint32(7);
+}
+
+static void sourceStamp(const QString &path, qint64 &lastModified, qint64 &size)
+{
+    const QFileInfo info(path);
+    if (!info.exists()) {
+        lastModified = -1;
+        size = -1;
+        return;
+    }
+    lastModified = info.lastModified().toMSecsSinceEpoch();
+    size = info.size();
+}
+
+static QStringList applicationRoots()
+{
+    return QStandardPaths::standardLocations(QStandardPaths::ApplicationsLocation);
+}
+
+static QStringList autostartRoots()
+{
+    QStringList roots;
+    const auto paths = QStandardPaths::standardLocations(QStandardPaths::GenericConfigLocation);
+    for (const auto &path : paths)
+        roots.append(path + QStringLiteral("/autostart"));
+    return roots;
+}
+
+static QByteArray rootsSignature()
+{
+    QByteArray signature;
+    const auto applications = applicationRoots();
+    for (const auto &path : applications) {
+        signature.append('A');
+        signature.append(QFile::encodeName(path));
+        signature.append('\n');
+    }
+    const auto autostart = autostartRoots();
+    for (const auto &path : autostart) {
+        signature.append('S');
+        signature.append(QFile::encodeName(path));
+        signature.append('\n');
+    }
+    return signature;
+}
+
+static void scanApplications(const QString &path, const QString &prefix,
+                             QStringList &sources, QHash<QByteArray, ParsedEntry> &entries)
+{
+    sources.append(path);
+
+    QDir dir(path);
+    const auto entryList = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    for (const auto &info : entryList) {
+        if (info.isDir()) {
+            scanApplications(info.filePath(), prefix + info.fileName() + QLatin1Char('-'),
+                             sources, entries);
+        } else if (info.fileName().endsWith(QLatin1String(".desktop"))) {
+            // Directories with higher precedence are scanned first
+            const QByteArray id = QString(prefix + info.fileName().chopped(8)).toUtf8();
+            if (entries.contains(id))
+                continue;
+
+            // Files edited in place don't change the directory
+            sources.append(info.filePath());
+
+            ParsedEntry entry;
+            entry.kind = ApplicationEntry;
+            if (!parseDesktopFile(info.filePath(), entry))
+                continue;
+            entry.fields[IdField] = id;
+            entry.fields[FileNameField] = QFile::encodeName(info.filePath());
+            entries.insert(id, entry);
+        }
+    }
+}
+
+static void scanAutostart(const QString &path, QStringList &sources,
+                          QHash<QByteArray, ParsedEntry> &entries)
+{
+    sources.append(path);
+
+    QDir dir(path);
+    const auto entryList = dir.entryInfoList(QStringList() << QStringLiteral("*.desktop"), QDir::Files);
+    for (const auto &info : entryList) {
+        // Entries with higher precedence replace the others, even hidden ones
+        const auto id = info.fileName().chopped(8).toUtf8();
+        if (entries.contains(id))
+            continue;
+
+        sources.append(info.filePath());
+
+        ParsedEntry entry;
+        entry.kind = AutostartEntry;
+        if (!parseDesktopFile(info.filePath(), entry))
+            continue;
+        entry.fields[IdField] = id;
+        entry.fields[FileNameField] = QFile::encodeName(info.filePath());
+        entries.insert(id, entry);
+    }
+}
+
+/*
+ * DesktopEntry
+ */
+
+DesktopEntry::DesktopEntry(const DesktopEntryCache *cache, const void *record)
+    : m_cache(cache)
+    , m_record(record)
+{
+}
+
+bool DesktopEntry::isValid() const
+{
+    return m_cache && m_record;
+}
+
+QString DesktopEntry::id() const
+{
+    return QString::fromUtf8(string(IdField));
+}
+
+QString DesktopEntry::fileName() const
+{
+    return QFile::decodeName(string(FileNameField));
+}
+
+QString DesktopEntry::type() const
+{
+    return QString::fromUtf8(string(TypeField));
+}
+
+QString DesktopEntry::name() const
+{
+    return localizedString(NameField, LocalizedNameField);
+}
+
+QString DesktopEntry::genericName() const
+{
+    return localizedString(GenericNameField, LocalizedGenericNameField);
+}
+
+QString DesktopEntry::comment() const
+{
+    return localizedString(CommentField, LocalizedCommentField);
+}
+
+QString DesktopEntry::icon() const
+{
+    return QString::fromUtf8(string(IconField));
+}
+
+QString DesktopEntry::exec() const
+{
+    return QString::fromUtf8(string(ExecField));
+}
+
+QString DesktopEntry::tryExec() const
+{
+    return QString::fromUtf8(string(TryExecField));
+}
+
+QString DesktopEntry::workingDirectory() const
+{
+    return QString::fromUtf8(string(PathField));
+}
+
+QStringList DesktopEntry::categories() const
+{
+    return stringList(CategoriesField);
+}
+
+QStringList DesktopEntry::mimeTypes() const
+{
+    return stringList(MimeTypeField);
+}
+
+QStringList DesktopEntry::onlyShowIn() const
+{
+    return stringList(OnlyShowInField);
+}
+
+QStringList DesktopEntry::notShowIn() const
+{
+    return stringList(NotShowInField);
+}
+
+int DesktopEntry::autostartDelay() const
+{
+    return qMax(0, QByteArray(string(AutostartDelayField)).toInt());
+}
+
+QString DesktopEntry::autostartPhase() const
+{
+    return QString::fromUtf8(string(AutostartPhaseField));
+}
+
+QString DesktopEntry::resourceProfile() const
+{
+    return QString::fromUtf8(string(ResourceProfileField));
+}
+
+bool DesktopEntry::isDBusActivatable() const
+{
+    return flag(DBusActivatableFlag);
+}
+
+bool DesktopEntry::isHidden() const
+{
+    return flag(HiddenFlag);
+}
+
+bool DesktopEntry::isNoDisplay() const
+{
+    return flag(NoDisplayFlag);
+}
+
+bool DesktopEntry::isTerminal() const
+{
+    return flag(TerminalFlag);
+}
+
+bool DesktopEntry::isHiddenUnderSystemd() const
+{
+    return flag(HiddenUnderSystemdFlag);
+}
+
+bool DesktopEntry::isSuitable(const QString &desktop) const
+{
+    const auto only = onlyShowIn();
+    if (!only.isEmpty() && !only.contains(desktop))
+        return false;
+
+    return !notShowIn().contains(desktop);
+}
+
+QStringList DesktopEntry::expandExec(const QStringList &urls) const
+{
+    // Split arguments as described by the desktop entry specification,
+    // reserved characters must be quoted and escaped inside quotes
+    const auto command = exec();
+    QStringList tokens;
+    QString token;
+    bool inToken = false;
+    bool quoted = false;
+    for (int i = 0; i < command.size(); ++i) {
+        const auto c = command.at(i);
+        if (quoted) {
+            if (c == QLatin1Char('\\') && i + 1 < command.size()) {
+                token.append(command.at(++i));
+            } else if (c == QLatin1Char('"')) {
+                quoted = false;
+            } else {
+                token.append(c);
+            }
+        } else if (c == QLatin1Char('"')) {
+            quoted = true;
+            inToken = true;
+        } else if (c == QLatin1Char(' ')) {
+            if (inToken)
+                tokens.append(token);
+            token.clear();
+            inToken = false;
+        } else {
+            token.append(c);
+            inToken = true;
+        }
+    }
+    if (inToken)
+        tokens.append(token);
+
+    // Local files for %f and %F, and URLs for %u and %U
+    QStringList files;
+    for (const auto &url : urls) {
+        const auto qurl = QUrl::fromUserInput(url);
+        if (qurl.isLocalFile())
+            files.append(qurl.toLocalFile());
+    }
+
+    QStringList args;
+    for (const auto &arg : qAsConst(tokens)) {
+        // Field codes that expand to multiple arguments
+        if (arg == QLatin1String("%F")) {
+            args.append(files);
+            continue;
+        } else if (arg == QLatin1String("%U")) {
+            args.append(urls);
+            continue;
+        } else if (arg == QLatin1String("%i")) {
+            if (!icon().isEmpty())
+                args << QStringLiteral("--icon") << icon();
+            continue;
+        }
+
+        QString expanded;
+        for (int i = 0; i < arg.size(); ++i) {
+            const auto c = arg.at(i);
+            if (c != QLatin1Char('%') || i + 1 >= arg.size()) {
+                expanded.append(c);
+                continue;
+            }
+
+            switch (arg.at(++i).toLatin1()) {
+            case 'f':
+                if (!files.isEmpty())
+                    expanded.append(files.first());
+                break;
+            case 'u':
+                if (!urls.isEmpty())
+                    expanded.append(urls.first());
+                break;
+            case 'c':
+                expanded.append(name());
+                break;
+            case 'k':
+                expanded.append(fileName());
+                break;
+            case '%':
+                expanded.append(QLatin1Char('%'));
+                break;
+            default:
+                // Deprecated and unknown field codes are removed
+                break;
+            }
+        }
+
+        if (!expanded.isEmpty())
+            args.append(expanded);
+    }
+
+    return args;
+}
+
+const char *DesktopEntry::string(int field) const
+{
+    if (!isValid())
+        return "";
+    auto *record = static_cast<const CacheRecord *>(m_record);
+    return m_cache->string(record->strings[field]);
+}
+
+QString DesktopEntry::localizedString(int field, int localizedField) const
+{
+    const char *localized = string(localizedField);
+    if (*localized) {
+        // Try language with country first, then only language
+        const auto localeName = QLocale::system().name().toUtf8();
+        const auto candidates = QList<QByteArray>()
+                << localeName << localeName.left(localeName.indexOf('_'));
+
+        const auto pairs = QByteArray::fromRawData(localized, int(strlen(localized))).split(LocaleSeparator);
+        for (const auto &candidate : candidates) {
+            for (const auto &pair : pairs) {
+                const int index = pair.indexOf(ListSeparator);
+                if (index > 0 && pair.left(index) == candidate)
+                    return QString::fromUtf8(pair.mid(index + 1));
+            }
+        }
+    }
+
+    return QString::fromUtf8(string(field));
+}
+
+QStringList DesktopEntry::stringList(int field) const
+{
+    const char *value = string(field);
+    if (!*value)
+        return QStringList();
+    return QString::fromUtf8(value).split(QLatin1Char(ListSeparator));
+}
+
+bool DesktopEntry::flag(quint32 mask) const
+{
+    if (!isValid())
+        return false;
+    return static_cast<const CacheRecord *>(m_record)->flags & mask;
+}
+
+/*
+ * DesktopEntryCache
+ */
+
+DesktopEntryCache::DesktopEntryCache()
+{
+}
+
+DesktopEntryCache::~DesktopEntryCache()
+{
+    close();
+}
+
+DesktopEntry DesktopEntryCache::application(const QString &appId)
+{
+    if (!ensureLoaded())
+        return DesktopEntry();
+    return find(ApplicationEntry, appId.toUtf8(), false);
+}
+
+DesktopEntry DesktopEntryCache::entryForFile(const QString &fileName)
+{
+    if (!ensureLoaded())
+        return DesktopEntry();
+
+    const auto key = QFile::encodeName(QDir::cleanPath(fileName));
+    const auto entry = find(ApplicationEntry, key, true);
+    if (entry.isValid())
+        return entry;
+    return find(AutostartEntry, key, true);
+}
+
+QVector<DesktopEntry> DesktopEntryCache::autostartEntries()
+{
+    QVector<DesktopEntry> entries;
+    if (!ensureLoaded())
+        return entries;
+
+    auto *header = reinterpret_cast<const CacheHeader *>(m_data);
+    for (quint32 i = 0; i < header->entryCount; ++i) {
+        const auto entry = entryAt(i);
+        if (static_cast<const CacheRecord *>(entry.m_record)->kind == AutostartEntry)
+            entries.append(entry);
+    }
+
+    return entries;
+}
+
+void DesktopEntryCache::invalidate()
+{
+    close();
+    m_loaded = false;
+}
+
+QString DesktopEntryCache::cacheFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+            QStringLiteral("/liri-session/desktop-entries.cache");
+}
+
+bool DesktopEntryCache::ensureLoaded()
+{
+    if (m_loaded)
+        return m_data != nullptr;
+    m_loaded = true;
+
+    // The cache is validated only once, it's rebuilt when it's missing
+    // or when any directory or desktop file was modified since it was written
+    if (open() && isUpToDate())
+        return true;
+
+    close();
+    if (!rebuild())
+        return false;
+
+    return open();
+}
+
+bool DesktopEntryCache::open()
+{
+    m_file.setFileName(cacheFileName());
+    if (!m_file.open(QFile::ReadOnly))
+        return false;
+
+    m_size = m_file.size();
+    if (m_size < qint64(sizeof(CacheHeader))) {
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        close();
+        return false;
+    }
+
+    // Check that everything is within the file
+    auto *header = reinterpret_cast<const CacheHeader *>(m_data);
+    const quint64 sourcesEnd = quint64(header->sourcesOffset) +
+            quint64(header->sourceCount) * sizeof(CacheSource);
+    const quint64 entriesEnd = quint64(header->entriesOffset) +
+            quint64(header->entryCount) * sizeof(CacheRecord);
+    const quint64 indexEnd = quint64(header->fileNameIndexOffset) +
+            quint64(header->entryCount) * sizeof(quint32);
+    const quint64 stringsEnd = quint64(header->stringsOffset) + header->stringsSize;
+    if (header->magic != CacheMagic || header->version != CacheVersion ||
+            sourcesEnd > quint64(m_size) || entriesEnd > quint64(m_size) ||
+            indexEnd > quint64(m_size) || stringsEnd > quint64(m_size) ||
+            header->stringsSize == 0 ||
+            m_data[header->stringsOffset + header->stringsSize - 1] != '\0') {
+        qCDebug(lcDesktopEntryCache, "Ignoring invalid cache %s",
+                qPrintable(m_file.fileName()));
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void DesktopEntryCache::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_data = nullptr;
+    }
+    m_size = 0;
+    m_file.close();
+}
+
+bool DesktopEntryCache::isUpToDate() const
+{
+    auto *header = reinterpret_cast<const CacheHeader *>(m_data);
+
+    if (rootsSignature() != string(header->roots))
+        return false;
+
+    auto *sources = reinterpret_cast<const CacheSource *>(m_data + header->sourcesOffset);
+    for (quint32 i = 0; i < header->sourceCount; ++i) {
+        qint64 lastModified, size;
+        sourceStamp(QFile::decodeName(string(sources[i].path)), lastModified, size);
+        if (lastModified != sources[i].lastModified || size != sources[i].size)
+            return false;
+    }
+
+    return true;
+}
+
+bool DesktopEntryCache::rebuild()
+{
+    qCDebug(lcDesktopEntryCache, "Rebuilding desktop entries cache");
+
+    QStringList sources;
+    QHash<QByteArray, ParsedEntry> applications;
+    QHash<QByteArray, ParsedEntry> autostart;
+
+    const auto applicationPaths = applicationRoots();
+    for (const auto &path : applicationPaths) {
+        if (QFileInfo::exists(path))
+            scanApplications(path, QString(), sources, applications);
+        else
+            sources.append(path);
+    }
+    const auto autostartPaths = autostartRoots();
+    for (const auto &path : autostartPaths)
+        scanAutostart(path, sources, autostart);
+
+    // Sort by kind and ID for binary search
+    QVector<ParsedEntry> entries;
+    entries.reserve(applications.size() + autostart.size());
+    auto sortedKeys = applications.keys();
+    std::sort(sortedKeys.begin(), sortedKeys.end());
+    for (const auto &key : qAsConst(sortedKeys))
+        entries.append(applications.value(key));
+    sortedKeys = autostart.keys();
+    std::sort(sortedKeys.begin(), sortedKeys.end());
+    for (const auto &key : qAsConst(sortedKeys))
+        entries.append(autostart.value(key));
+
+    QVector<quint32> fileNameIndex(entries.size());
+    for (int i = 0; i < entries.size(); ++i)
+        fileNameIndex[i] = i;
+    std::sort(fileNameIndex.begin(), fileNameIndex.end(), [&entries](quint32 a, quint32 b) {
+        const auto &left = entries.at(a);
+        const auto &right = entries.at(b);
+        if (left.kind != right.kind)
+            return left.kind < right.kind;
+        return left.fields[FileNameField] < right.fields[FileNameField];
+    });
+
+    CacheWriter writer;
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CacheMagic;
+    header.version = CacheVersion;
+    header.roots = writer.addString(rootsSignature());
+    header.sourceCount = sources.size();
+    header.sourcesOffset = align(sizeof(CacheHeader));
+    header.entryCount = entries.size();
+    header.entriesOffset = align(header.sourcesOffset + header.sourceCount * sizeof(CacheSource));
+    header.fileNameIndexOffset = align(header.entriesOffset + header.entryCount * sizeof(CacheRecord));
+
+    QVector<CacheSource> sourceRecords;
+    for (const auto &path : qAsConst(sources)) {
+        CacheSource record;
+        record.path = writer.addString(QFile::encodeName(path));
+        record.reserved = 0;
+        sourceStamp(path, record.lastModified, record.size);
+        sourceRecords.append(record);
+    }
+
+    QVector<CacheRecord> records;
+    for (const auto &entry : qAsConst(entries)) {
+        CacheRecord record;
+        record.kind = entry.kind;
+        record.flags = entry.flags;
+        for (int i = 0; i < FieldCount; ++i)
+            record.strings[i] = writer.addString(entry.fields[i]);
+        records.append(record);
+    }
+
+    const auto strings = writer.strings();
+    header.stringsOffset = align(header.fileNameIndexOffset + header.entryCount * sizeof(quint32));
+    header.stringsSize = strings.size();
+
+    QByteArray data(header.stringsOffset + header.stringsSize, '\0');
+    memcpy(data.data(), &header, sizeof(header));
+    if (!sourceRecords.isEmpty())
+        memcpy(data.data() + header.sourcesOffset, sourceRecords.constData(),
+               sourceRecords.size() * sizeof(CacheSource));
+    if (!records.isEmpty()) {
+        memcpy(data.data() + header.entriesOffset, records.constData(),
+               records.size() * sizeof(CacheRecord));
+        memcpy(data.data() + header.fileNameIndexOffset, fileNameIndex.constData(),
+               fileNameIndex.size() * sizeof(quint32));
+    }
+    memcpy(data.data() + header.stringsOffset, strings.constData(), strings.size());
+
+    const auto fileName = cacheFileName();
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qCWarning(lcDesktopEntryCache, "Failed to write desktop entries cache %s: %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+
+    return true;
+}
+
+const char *DesktopEntryCache::string(quint32 offset) const
+{
+    auto *header = reinterpret_cast<const CacheHeader *>(m_data);
+    if (offset >= header->stringsSize)
+        return "";
+    return reinterpret_cast<const char *>(m_data + header->stringsOffset + offset);
+}
+
+DesktopEntry DesktopEntryCache::entryAt(quint32 index) const
+{
+    auto *header = reinterpret_cast<const CacheHeader *>(m_data);
+    auto *records = reinterpret_cast<const CacheRecord *>(m_data + header->entriesOffset);
+    return DesktopEntry(this, &records[index]);
+}
+
+DesktopEntry DesktopEntryCache::find(quint32 kind, const QByteArray &key, bool byFileName) const
+{
+    auto *header = reinterpret_cast<const CacheHeader *>(m_data);
+    auto *records = reinterpret_cast<const CacheRecord *>(m_data + header->entriesOffset);
+    auto *fileNameIndex = reinterpret_cast<const quint32 *>(m_data + header->fileNameIndexOffset);
+    const int field = byFileName ? FileNameField : IdField;
+
+    // Binary search on records sorted by kind and key
+    quint32 low = 0, high = header->entryCount;
+    while (low < high) {
+        const quint32 middle = low + (high - low) / 2;
+        const quint32 index = byFileName ? fileNameIndex[middle] : middle;
+        if (index >= header->entryCount)
+            return DesktopEntry();
+        const auto &record = records[index];
+
+        int result;
+        if (record.kind != kind)
+            result = record.kind < kind ? -1 : 1;
+        else
+            result = strcmp(string(record.strings[field]), key.constData());
+
+        if (result == 0)
+            return DesktopEntry(this, &record);
+        else if (result < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return DesktopEntry();
+}
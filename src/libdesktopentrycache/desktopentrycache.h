@@ -0,0 +1,110 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef DESKTOPENTRYCACHE_H
+#define DESKTOPENTRYCACHE_H
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QStringList>
+#include <QVector>
+
+Q_DECLARE_LOGGING_CATEGORY(lcDesktopEntryCache)
+
+class DesktopEntryCache;
+
+/*
+ * A desktop entry read from the cache.
+ *
+ * Entries point directly to the memory mapped cache file, hence they
+ * must not be used after the cache is invalidated or destroyed.
+ */
+class DesktopEntry
+{
+public:
+    DesktopEntry() = default;
+
+    bool isValid() const;
+
+    QString id() const;
+    QString fileName() const;
+
+    // Application, Link or Directory
+    QString type() const;
+    QString name() const;
+    QString genericName() const;
+    QString comment() const;
+    QString icon() const;
+    QString exec() const;
+    QString tryExec() const;
+    QString workingDirectory() const;
+    QStringList categories() const;
+    QStringList mimeTypes() const;
+    QStringList onlyShowIn() const;
+    QStringList notShowIn() const;
+
+    // Seconds to wait before autostarting
+    int autostartDelay() const;
+    QString autostartPhase() const;
+
+    QString resourceProfile() const;
+
+    bool isDBusActivatable() const;
+    bool isHidden() const;
+    bool isNoDisplay() const;
+    bool isTerminal() const;
+    bool isHiddenUnderSystemd() const;
+
+    bool isSuitable(const QString &desktop) const;
+
+    QStringList expandExec(const QStringList &urls = QStringList()) const;
+
+private:
+    friend class DesktopEntryCache;
+
+    const DesktopEntryCache *m_cache = nullptr;
+    const void *m_record = nullptr;
+
+    DesktopEntry(const DesktopEntryCache *cache, const void *record);
+
+    const char *string(int field) const;
+    QString localizedString(int field, int localizedField) const;
+    QStringList stringList(int field) const;
+    bool flag(quint32 mask) const;
+};
+
+class DesktopEntryCache
+{
+public:
+    DesktopEntryCache();
+    ~DesktopEntryCache();
+
+    DesktopEntry application(const QString &appId);
+    DesktopEntry entryForFile(const QString &fileName);
+    QVector<DesktopEntry> autostartEntries();
+
+    void invalidate();
+
+    static QString cacheFileName();
+
+private:
+    friend class DesktopEntry;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    qint64 m_size = 0;
+    bool m_loaded = false;
+
+    bool ensureLoaded();
+    bool open();
+    void close();
+    bool isUpToDate() const;
+    bool rebuild();
+
+    const char *string(quint32 offset) const;
+    DesktopEntry entryAt(quint32 index) const;
+    DesktopEntry find(quint32 kind, const QByteArray &key, bool byFileName) const;
+};
+
+#endif // DESKTOPENTRYCACHE_H
@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QByteArray>
+
+#include "journalstream.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char journalStreamPath[] = "/run/systemd/journal/stdout";
+
+namespace JournalStream {
+
+int open(const QString &identifier, Priority priority)
+{
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+
+    struct sockaddr_un address;
+    ::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    ::memcpy(address.sun_path, journalStreamPath, sizeof(journalStreamPath));
+
+    int result;
+    do {
+        result = ::connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address));
+    } while (result < 0 && errno == EINTR);
+    if (result < 0) {
+        ::close(fd);
+        return -1;
+    }
+
+    // Nothing will ever be read from it
+    ::shutdown(fd, SHUT_RD);
+
+    // Same header of sd_journal_stream_fd(): identifier, unit (unused),
+    // priority, level prefix, forward to syslog, kmsg and console;
+    // messages may override the priority with a "<N>" prefix
+    QByteArray header = identifier.toUtf8();
+    header.replace('\n', ' ');
+    header.append("\n\n");
+    header.append(QByteArray::number(int(priority)));
+    header.append("\n1\n0\n0\n0\n");
+
+    qsizetype written = 0;
+    while (written < header.size()) {
+        const ssize_t size = ::write(fd, header.constData() + written,
+                                     static_cast<size_t>(header.size() - written));
+        if (size < 0 && errno == EINTR)
+            continue;
+        if (size <= 0) {
+            ::close(fd);
+            return -1;
+        }
+        written += size;
+    }
+
+    return fd;
+}
+
+} // namespace JournalStream
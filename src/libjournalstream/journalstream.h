@@ -0,0 +1,30 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef JOURNALSTREAM_H
+#define JOURNALSTREAM_H
+
+#include <QString>
+
+namespace JournalStream {
+
+// Priorities of the messages that don't have a "<N>" prefix
+enum Priority {
+    Error = 3,
+    Warning = 4,
+    Info = 6
+};
+
+/*
+ * Opens a stream to journald, like sd_journal_stream_fd() does, so that
+ * a child process can write its output directly to the journal.
+ *
+ * Returns a file descriptor with close-on-exec set, that becomes the
+ * child stdout or stderr with dup2(), or -1 if journald is not running.
+ */
+int open(const QString &identifier, Priority priority);
+
+} // namespace JournalStream
+
+#endif // JOURNALSTREAM_H
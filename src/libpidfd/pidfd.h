@@ -0,0 +1,24 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef PIDFD_H
+#define PIDFD_H
+
+#include <sys/types.h>
+
+namespace Pidfd {
+
+/*
+ * Wrappers of the pidfd system calls, that the C library might not have.
+ *
+ * A pidfd refers to a process even after its pid is recycled, and it
+ * becomes readable when the process exits, even if it's not our child.
+ * Both return -1 and set errno on failure.
+ */
+int open(pid_t pid);
+int sendSignal(int pidfd, int signum);
+
+} // namespace Pidfd
+
+#endif // PIDFD_H
@@ -0,0 +1,268 @@
+/****************************************************************************
+ * This file is part of Liri.
+ *
+ * Copyright (C) 2019 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+ *
+ * $BEGIN_LICENSE:GPL3+$
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * $END_LICENSE$
+ ***************************************************************************/
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QPluginLoader>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStaticPlugin>
+
+#include "pluginregistry.h"
+
+Q_LOGGING_CATEGORY(lcPluginRegistry, "liri.session.pluginregistry", QtInfoMsg)
+
+static const quint32 CacheMagic = 0x4c504d43; // "LPMC"
+static const quint32 CacheVersion = 1;
+
+static QDataStream &operator<<(QDataStream &stream, const PluginRegistry::CacheEntry &entry)
+{
+    stream << entry.size << entry.lastModified << entry.json;
+    return stream;
+}
+
+static QDataStream &operator>>(QDataStream &stream, PluginRegistry::CacheEntry &entry)
+{
+    stream >> entry.size >> entry.lastModified >> entry.json;
+    return stream;
+}
+
+PluginRegistry::PluginRegistry(const QString &type, const QStringList &interfaceIds,
+                               const QString &path, QObject *parent)
+    : QObject(parent)
+    , m_type(type)
+    , m_interfaceIds(interfaceIds)
+    , m_path(path)
+{
+}
+
+QStringList PluginRegistry::pluginNames() const
+{
+    // Sorted, so that modules are started and stopped in the same order
+    // every time, hash order changes from run to run
+    auto names = m_plugins.keys();
+    names.sort();
+    return names;
+}
+
+bool PluginRegistry::hasPlugin(const QString &name) const
+{
+    return m_plugins.contains(name);
+}
+
+bool PluginRegistry::isInstantiated(const QString &name) const
+{
+    auto it = m_plugins.constFind(name);
+    return it != m_plugins.constEnd() && it.value().instance;
+}
+
+QVariantMap PluginRegistry::getMetaData(const QString &name) const
+{
+    return m_plugins.value(name).metaData;
+}
+
+QObject *PluginRegistry::getInstance(const QString &name)
+{
+    auto it = m_plugins.find(name);
+    if (it == m_plugins.end())
+        return nullptr;
+
+    auto &entry = it.value();
+    if (entry.instance)
+        return entry.instance;
+
+    // Load the plugin the first time it's needed
+    if (entry.instanceFunction) {
+        entry.instance = entry.instanceFunction();
+    } else {
+        QPluginLoader loader(entry.fileName);
+        entry.instance = loader.instance();
+        if (!entry.instance)
+            qCWarning(lcPluginRegistry, "Failed to load plugin \"%s\": %s",
+                      qPrintable(name), qPrintable(loader.errorString()));
+    }
+
+    if (entry.instance) {
+        m_names.insert(entry.instance, name);
+
+        // Forget about instances that are deleted
+        connect(entry.instance, &QObject::destroyed, this, [this, name](QObject *object) {
+            m_names.remove(object);
+            auto it = m_plugins.find(name);
+            if (it != m_plugins.end() && it.value().instance == object)
+                it.value().instance = nullptr;
+        });
+    }
+
+    return entry.instance;
+}
+
+QString PluginRegistry::getNameForInstance(QObject *instance) const
+{
+    return m_names.value(instance);
+}
+
+void PluginRegistry::discover()
+{
+    // Find static plugins first
+    const auto staticPlugins = QPluginLoader::staticPlugins();
+    for (const QStaticPlugin &staticPlugin : staticPlugins) {
+        const auto json = staticPlugin.metaData().toVariantMap();
+        addPlugin(json, QString(), staticPlugin.instance);
+    }
+
+    // Find external plugins, only metadata is read here and
+    // libraries are not loaded until an instance is requested
+    readCache();
+
+    QHash<QString, CacheEntry> cache;
+    bool cacheChanged = false;
+
+    QDir pluginsDir(m_path);
+    const auto entryList = pluginsDir.entryInfoList(QDir::Files);
+    for (const auto &fileInfo : entryList) {
+        const auto filePath = fileInfo.absoluteFilePath();
+        const auto lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+        // Open the library only when it's not in the cache or it was modified
+        auto entry = m_cache.value(filePath);
+        if (entry.size != fileInfo.size() || entry.lastModified != lastModified) {
+            QPluginLoader loader(filePath);
+            entry.size = fileInfo.size();
+            entry.lastModified = lastModified;
+            entry.json = loader.metaData().toVariantMap();
+            cacheChanged = true;
+        }
+        cache.insert(filePath, entry);
+
+        if (!entry.json.isEmpty())
+            addPlugin(entry.json, filePath, nullptr);
+    }
+
+    // Plugins might have been removed too
+    if (cache.size() != m_cache.size())
+        cacheChanged = true;
+
+    m_cache = cache;
+    if (cacheChanged)
+        writeCache();
+}
+
+QString PluginRegistry::cacheFileName() const
+{
+    return QStringLiteral("%1/liri-session/%2-plugins.cache")
+            .arg(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation),
+                 m_type.toLower());
+}
+
+void PluginRegistry::readCache()
+{
+    m_cache.clear();
+
+    QFile file(cacheFileName());
+    if (!file.open(QFile::ReadOnly))
+        return;
+
+    // Map the file instead of reading it
+    const auto size = file.size();
+    auto *data = file.map(0, size);
+    if (!data)
+        return;
+    auto bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(data), size);
+
+    QDataStream stream(bytes);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic = 0, version = 0;
+    QString path;
+    stream >> magic >> version >> path;
+    if (magic != CacheMagic || version != CacheVersion || path != m_path) {
+        qCDebug(lcPluginRegistry, "Ignoring outdated plugin cache %s",
+                qPrintable(file.fileName()));
+    } else {
+        QHash<QString, CacheEntry> cache;
+        stream >> cache;
+        if (stream.status() == QDataStream::Ok)
+            m_cache = cache;
+        else
+            qCWarning(lcPluginRegistry, "Ignoring corrupted plugin cache %s",
+                      qPrintable(file.fileName()));
+    }
+
+    file.unmap(data);
+}
+
+void PluginRegistry::writeCache()
+{
+    const auto fileName = cacheFileName();
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(lcPluginRegistry, "Failed to write plugin cache %s: %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << CacheMagic << CacheVersion << m_path << m_cache;
+
+    if (!file.commit())
+        qCWarning(lcPluginRegistry, "Failed to write plugin cache %s: %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+}
+
+void PluginRegistry::addPlugin(const QVariantMap &json, const QString &fileName,
+                               QtPluginInstanceFunction instanceFunction)
+{
+    // Must have interface ID and metadata
+    if (!json.contains(QStringLiteral("IID")) ||
+            !json.contains(QStringLiteral("MetaData"))) {
+        qCWarning(lcPluginRegistry, "Ignoring invalid plugin");
+        return;
+    }
+
+    // Check the interface ID
+    if (!m_interfaceIds.contains(json[QStringLiteral("IID")].toString()))
+        return;
+
+    // Add to the list
+    const auto metaData = json[QStringLiteral("MetaData")].toMap();
+    const auto id = metaData.value(QStringLiteral("Id")).toString();
+    const auto type = metaData.value(QStringLiteral("Type")).toString();
+    if (type != m_type) {
+        qCWarning(lcPluginRegistry, "Plugin \"%s\" is of type %s instead of %s",
+                  qPrintable(id), qPrintable(type), qPrintable(m_type));
+        return;
+    }
+
+    PluginEntry entry;
+    entry.metaData = metaData;
+    entry.fileName = fileName;
+    entry.instanceFunction = instanceFunction;
+    m_plugins.insert(id, entry);
+}
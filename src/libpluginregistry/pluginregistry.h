@@ -24,33 +24,60 @@
 #ifndef PLUGINREGISTRY_H
 #define PLUGINREGISTRY_H
 
-#include <QObject>
 #include <QHash>
+#include <QLoggingCategory>
+#include <QObject>
+#include <QVariantMap>
+#include <QtPlugin>
 
-typedef QHash<QString, QObject *> PluginsMap;
+Q_DECLARE_LOGGING_CATEGORY(lcPluginRegistry)
 
 class PluginRegistry : public QObject
 {
     Q_OBJECT
 public:
-    explicit PluginRegistry(QObject *parent = nullptr);
+    explicit PluginRegistry(const QString &type, const QStringList &interfaceIds,
+                            const QString &path, QObject *parent = nullptr);
 
-    PluginsMap plugins() const;
+    QStringList pluginNames() const;
 
     bool hasPlugin(const QString &name) const;
+    bool isInstantiated(const QString &name) const;
 
     QVariantMap getMetaData(const QString &name) const;
-    QObject *getInstance(const QString &name) const;
+    QObject *getInstance(const QString &name);
 
     QString getNameForInstance(QObject *instance) const;
 
     void discover();
 
+    struct CacheEntry {
+        qint64 size = -1;
+        qint64 lastModified = -1;
+        QVariantMap json;
+    };
+
 private:
-    PluginsMap m_plugins;
-    QMap<QString, QVariantMap> m_pluginsMetaData;
+    struct PluginEntry {
+        QVariantMap metaData;
+        QString fileName;
+        QtPluginInstanceFunction instanceFunction = nullptr;
+        QObject *instance = nullptr;
+    };
+
+    QString m_type;
+    QStringList m_interfaceIds;
+    QString m_path;
+    QHash<QString, PluginEntry> m_plugins;
+    QHash<QObject *, QString> m_names;
+    QHash<QString, CacheEntry> m_cache;
+
+    void addPlugin(const QVariantMap &json, const QString &fileName,
+                   QtPluginInstanceFunction instanceFunction);
 
-    void addPlugin(QObject *instance, const QVariantMap &json);
+    QString cacheFileName() const;
+    void readCache();
+    void writeCache();
 };
 
 #endif // PLUGINREGISTRY_H
@@ -65,4 +65,24 @@ bool SessionModule::isSystemdEnabled() const
     return d->systemd;
 }
 
+// AsyncSessionModule
+
+AsyncSessionModule::AsyncSessionModule(QObject *parent)
+    : SessionModule(parent)
+{
+}
+
+bool AsyncSessionModule::start(const QStringList &args)
+{
+    // Callers of the synchronous API are not interested in the outcome
+    startAsync(args);
+    return true;
+}
+
+bool AsyncSessionModule::stop()
+{
+    stopAsync();
+    return true;
+}
+
 } // namespace Liri
@@ -30,6 +30,7 @@
 #include <LiriSession/lirisessionglobal.h>
 
 #define LiriSessionModule_iid "io.liri.Session.Module/1.0"
+#define LiriAsyncSessionModule_iid "io.liri.Session.Module/2.0"
 
 namespace Liri {
 
@@ -69,8 +70,30 @@ private:
     SessionModulePrivate *const d_ptr;
 };
 
+class LIRISESSION_EXPORT AsyncSessionModule : public SessionModule
+{
+    Q_OBJECT
+public:
+    explicit AsyncSessionModule(QObject *parent = nullptr);
+
+    // Begin starting the module, ready() or failed() is emitted when done
+    virtual void startAsync(const QStringList &args = QStringList()) = 0;
+
+    // Begin stopping the module, stopped() is emitted when done
+    virtual void stopAsync() = 0;
+
+    bool start(const QStringList &args = QStringList()) override;
+    bool stop() override;
+
+Q_SIGNALS:
+    void ready();
+    void failed(const QString &errorMessage);
+    void stopped();
+};
+
 } // namespace Liri
 
 Q_DECLARE_INTERFACE(Liri::SessionModule, LiriSessionModule_iid)
+Q_DECLARE_INTERFACE(Liri::AsyncSessionModule, LiriAsyncSessionModule_iid)
 
 #endif // LIRI_SESSIONMODULE_H
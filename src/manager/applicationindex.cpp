@@ -0,0 +1,163 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QStandardPaths>
+#include <QTimer>
+
+#include "applicationindex.h"
+#include "session.h"
+
+// Changes are collected for this amount of milliseconds, so that
+// installing a package doesn't trigger a rescan for each file
+static const int updateDelay = 200;
+
+ApplicationIndex::ApplicationIndex(QObject *parent)
+    : QObject(parent)
+    , m_watcher(new QFileSystemWatcher(this))
+{
+    m_updateTimer = new QTimer(this);
+    m_updateTimer->setSingleShot(true);
+    m_updateTimer->setInterval(updateDelay);
+    connect(m_updateTimer, &QTimer::timeout,
+            this, &ApplicationIndex::update);
+
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged,
+            this, &ApplicationIndex::handleDirectoryChanged);
+
+    // Directories are in order of precedence
+    const auto paths = QStandardPaths::standardLocations(QStandardPaths::ApplicationsLocation);
+    for (const auto &path : paths) {
+        Root root;
+        root.path = QDir::cleanPath(path);
+        scanRoot(root);
+        m_roots.append(root);
+    }
+
+    rebuild();
+}
+
+QString ApplicationIndex::fileName(const QString &appId) const
+{
+    return m_fileNames.value(appId);
+}
+
+QString ApplicationIndex::appId(const QString &fileName) const
+{
+    return m_appIds.value(QDir::cleanPath(fileName));
+}
+
+QStringList ApplicationIndex::appIds() const
+{
+    return m_fileNames.keys();
+}
+
+void ApplicationIndex::scanRoot(Root &root)
+{
+    root.entries.clear();
+
+    // Watch the parent of directories that don't exist yet,
+    // to know when they are created
+    if (!QFileInfo::exists(root.path)) {
+        const auto parentPath = QFileInfo(root.path).path();
+        if (QFileInfo::exists(parentPath))
+            watchDirectory(parentPath);
+        return;
+    }
+
+    QSet<QString> visited;
+    scanDirectory(root, root.path, QString(), visited);
+}
+
+void ApplicationIndex::scanDirectory(Root &root, const QString &path, const QString &prefix,
+                                     QSet<QString> &visited)
+{
+    QDir dir(path);
+    if (!dir.exists())
+        return;
+
+    // Symbolic links to directories may form a loop
+    const auto canonicalPath = dir.canonicalPath();
+    if (visited.contains(canonicalPath))
+        return;
+    visited.insert(canonicalPath);
+
+    // Subdirectories are watched too, because they contribute to the ID
+    watchDirectory(path);
+
+    const auto entries = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+    for (const auto &entry : entries) {
+        if (entry.isDir()) {
+            scanDirectory(root, entry.filePath(), prefix + entry.fileName() + QLatin1Char('-'),
+                          visited);
+        } else if (entry.fileName().endsWith(QLatin1String(".desktop"))) {
+            const QString id = prefix + entry.fileName().chopped(8);
+            if (!root.entries.contains(id))
+                root.entries.insert(id, entry.filePath());
+        }
+    }
+}
+
+void ApplicationIndex::watchDirectory(const QString &path)
+{
+    if (m_watchedPaths.contains(path))
+        return;
+
+    if (m_watcher->addPath(path))
+        m_watchedPaths.insert(path);
+}
+
+void ApplicationIndex::rebuild()
+{
+    m_fileNames.clear();
+    m_appIds.clear();
+
+    // Entries of directories with higher precedence win
+    for (auto it = m_roots.crbegin(); it != m_roots.crend(); ++it) {
+        for (auto entry = it->entries.constBegin(); entry != it->entries.constEnd(); ++entry)
+            m_fileNames.insert(entry.key(), entry.value());
+    }
+    for (auto it = m_fileNames.constBegin(); it != m_fileNames.constEnd(); ++it)
+        m_appIds.insert(it.value(), it.key());
+}
+
+void ApplicationIndex::handleDirectoryChanged(const QString &path)
+{
+    for (int i = 0; i < m_roots.size(); ++i) {
+        const auto &rootPath = m_roots.at(i).path;
+        if (path == rootPath || path.startsWith(rootPath + QLatin1Char('/')) ||
+                path == QFileInfo(rootPath).path())
+            m_dirtyRoots.insert(i);
+    }
+
+    if (!m_updateTimer->isActive())
+        m_updateTimer->start();
+}
+
+void ApplicationIndex::update()
+{
+    // Removed directories are no longer watched, the watcher might
+    // have dropped some on its own so it's the reference here
+    m_watchedPaths.clear();
+    const auto watched = m_watcher->directories();
+    for (const auto &path : watched) {
+        if (QFileInfo::exists(path))
+            m_watchedPaths.insert(path);
+        else
+            m_watcher->removePath(path);
+    }
+
+    for (int i : qAsConst(m_dirtyRoots))
+        scanRoot(m_roots[i]);
+    m_dirtyRoots.clear();
+
+    rebuild();
+
+    qCDebug(lcSession, "Application index updated, %d applications",
+            int(m_fileNames.size()));
+
+    Q_EMIT changed();
+}
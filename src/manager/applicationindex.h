@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef APPLICATIONINDEX_H
+#define APPLICATIONINDEX_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QVector>
+
+class QFileSystemWatcher;
+class QTimer;
+
+class ApplicationIndex : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ApplicationIndex(QObject *parent = nullptr);
+
+    QString fileName(const QString &appId) const;
+    QString appId(const QString &fileName) const;
+
+    QStringList appIds() const;
+
+Q_SIGNALS:
+    void changed();
+
+private:
+    struct Root {
+        QString path;
+        // Desktop file ID to file name
+        QHash<QString, QString> entries;
+    };
+
+    QVector<Root> m_roots;
+    QHash<QString, QString> m_fileNames;
+    QHash<QString, QString> m_appIds;
+    QFileSystemWatcher *m_watcher = nullptr;
+    // Same as the watcher directories, without copying them for each lookup
+    QSet<QString> m_watchedPaths;
+    QTimer *m_updateTimer = nullptr;
+    QSet<int> m_dirtyRoots;
+
+    void scanRoot(Root &root);
+    void scanDirectory(Root &root, const QString &path, const QString &prefix,
+                       QSet<QString> &visited);
+    void watchDirectory(const QString &path);
+    void rebuild();
+    void handleDirectoryChanged(const QString &path);
+    void update();
+};
+
+#endif // APPLICATIONINDEX_H
@@ -0,0 +1,353 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QSocketNotifier>
+
+#include "applicationoutput.h"
+#include "session.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Most recent output kept for each application, in bytes
+static const int bufferCapacity = 64 * 1024;
+
+// Buffers of applications that haven't written anything for the
+// longest time are dropped when there are more than this, running or not
+static const int maxBuffers = 64;
+
+// Output moved at once, the default capacity of a pipe
+static const int chunkSize = 64 * 1024;
+
+// Chunks moved before going back to the event loop, so that
+// a chatty application can't keep us busy
+static const int maxChunks = 4;
+
+// Capacity of the pipes of the children, the default maximum size
+// for unprivileged processes: it lets them go on writing while
+// we are busy, instead of blocking after the default 64 KiB
+static const int pipeSize = 1024 * 1024;
+
+static void skip(int fd, qsizetype size)
+{
+    char buffer[4096];
+    while (size > 0) {
+        const ssize_t skipped = ::read(fd, buffer, static_cast<size_t>(qMin<qsizetype>(size, sizeof(buffer))));
+        if (skipped < 0 && errno == EINTR)
+            continue;
+        if (skipped <= 0)
+            break;
+        size -= skipped;
+    }
+}
+
+// Moves up to size bytes from a pipe to a non-blocking descriptor and
+// returns how many were moved, what it can't take right away is left
+// in the pipe, so that the writer waits for it like it would without us
+static qsizetype forward(int fromFd, int toFd, qsizetype size)
+{
+    if (toFd < 0) {
+        skip(fromFd, size);
+        return size;
+    }
+
+    qsizetype forwarded = 0;
+    while (forwarded < size) {
+        ssize_t moved = ::splice(fromFd, nullptr, toFd, nullptr, static_cast<size_t>(size - forwarded),
+                                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (moved < 0 && errno == EINTR)
+            continue;
+
+        // Not everything supports splice(), a terminal for example, here
+        // a short write loses the rest of what was read: it's never the
+        // journal, only our stderr when journald is not running
+        if (moved < 0 && errno == EINVAL) {
+            char buffer[4096];
+            moved = ::read(fromFd, buffer, static_cast<size_t>(qMin<qsizetype>(size - forwarded, sizeof(buffer))));
+            if (moved > 0) {
+                const ssize_t written = ::write(toFd, buffer, static_cast<size_t>(moved));
+                Q_UNUSED(written)
+            }
+        }
+
+        if (moved <= 0)
+            break;
+        forwarded += moved;
+    }
+
+    return forwarded;
+}
+
+/*
+ * OutputBuffer
+ */
+
+OutputBuffer::OutputBuffer(int capacity)
+{
+    m_lastWriteTimer.start();
+
+    m_fd = ::memfd_create("liri-session-output", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (m_fd < 0) {
+        qCWarning(lcSession, "Failed to create output buffer: %s", strerror(errno));
+        return;
+    }
+
+    // The size can't be changed anymore, so the cap is enforced by the kernel
+    if (::ftruncate(m_fd, static_cast<off_t>(capacity)) < 0 ||
+            ::fcntl(m_fd, F_ADD_SEALS, F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL) < 0) {
+        qCWarning(lcSession, "Failed to set up output buffer: %s", strerror(errno));
+        ::close(m_fd);
+        m_fd = -1;
+        return;
+    }
+
+    m_capacity = capacity;
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+bool OutputBuffer::isValid() const
+{
+    return m_fd >= 0;
+}
+
+bool OutputBuffer::appendFromPipe(int pipeFd, qsizetype size)
+{
+    if (!isValid())
+        return false;
+
+    m_lastWriteTimer.start();
+
+    while (size > 0) {
+        const qsizetype position = static_cast<qsizetype>(m_written % quint64(m_capacity));
+        const qsizetype chunk = qMin<qsizetype>(size, m_capacity - position);
+
+        loff_t offset = position;
+        ssize_t moved;
+        do {
+            moved = ::splice(pipeFd, nullptr, m_fd, &offset,
+                             static_cast<size_t>(chunk), SPLICE_F_MOVE);
+        } while (moved < 0 && errno == EINTR);
+        if (moved <= 0)
+            return false;
+
+        m_written += quint64(moved);
+        size -= moved;
+    }
+
+    return true;
+}
+
+QByteArray OutputBuffer::contents() const
+{
+    if (!isValid())
+        return QByteArray();
+
+    const quint64 capacity = quint64(m_capacity);
+    const quint64 size = qMin(m_written, capacity);
+    const quint64 position = (m_written - size) % capacity;
+    const quint64 first = qMin(size, capacity - position);
+
+    QByteArray result(static_cast<qsizetype>(size), Qt::Uninitialized);
+    if (::pread(m_fd, result.data(), static_cast<size_t>(first), static_cast<off_t>(position)) !=
+                static_cast<ssize_t>(first) ||
+            ::pread(m_fd, result.data() + first, static_cast<size_t>(size - first), 0) !=
+                static_cast<ssize_t>(size - first))
+        return QByteArray();
+
+    return result;
+}
+
+qint64 OutputBuffer::lastWrite() const
+{
+    return m_lastWriteTimer.msecsSinceReference();
+}
+
+/*
+ * ApplicationOutput
+ */
+
+ApplicationOutput::ApplicationOutput(QObject *parent)
+    : QObject(parent)
+{
+    // Output is duplicated here before being moved, as tee()
+    // only works between pipes
+    if (::pipe2(m_teePipe, O_CLOEXEC | O_NONBLOCK) < 0)
+        qCWarning(lcSession, "Failed to create pipe: %s", strerror(errno));
+}
+
+ApplicationOutput::~ApplicationOutput()
+{
+    const auto streams = m_streams.values();
+    for (auto *stream : streams)
+        closeStream(stream);
+
+    qDeleteAll(m_buffers);
+
+    if (m_teePipe[0] >= 0) {
+        ::close(m_teePipe[0]);
+        ::close(m_teePipe[1]);
+    }
+}
+
+int ApplicationOutput::openStream(const QString &appId, JournalStream::Priority priority)
+{
+    if (m_teePipe[0] < 0)
+        return -1;
+
+    // Only our end is non-blocking
+    int fds[2];
+    if (::pipe2(fds, O_CLOEXEC) < 0) {
+        qCWarning(lcSession, "Failed to create pipe: %s", strerror(errno));
+        return -1;
+    }
+    ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    ::fcntl(fds[0], F_SETPIPE_SZ, pipeSize);
+
+    auto *stream = new Stream;
+    stream->appId = appId;
+    stream->fd = fds[0];
+
+    // Output goes where ours goes when journald is not running; stderr
+    // is opened again, because a duplicate would share its blocking mode
+    stream->outputFd = JournalStream::open(appId, priority);
+    if (stream->outputFd >= 0)
+        ::fcntl(stream->outputFd, F_SETFL, ::fcntl(stream->outputFd, F_GETFL) | O_NONBLOCK);
+    else
+        stream->outputFd = ::open("/proc/self/fd/2", O_WRONLY | O_CLOEXEC | O_NONBLOCK);
+
+    const int fd = stream->fd;
+    stream->notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(stream->notifier, &QSocketNotifier::activated, this, [this, fd] {
+        handleStream(fd);
+    });
+
+    // Reading is paused while the output is full, until it can take more
+    if (stream->outputFd >= 0) {
+        stream->outputNotifier = new QSocketNotifier(stream->outputFd, QSocketNotifier::Write, this);
+        stream->outputNotifier->setEnabled(false);
+        connect(stream->outputNotifier, &QSocketNotifier::activated, this, [this, fd] {
+            auto *stream = m_streams.value(fd);
+            if (!stream)
+                return;
+            stream->outputNotifier->setEnabled(false);
+            stream->notifier->setEnabled(true);
+            handleStream(fd);
+        });
+    }
+
+    m_streams.insert(fd, stream);
+
+    return fds[1];
+}
+
+QByteArray ApplicationOutput::recentOutput(const QString &appId) const
+{
+    auto *buffer = m_buffers.value(appId);
+    return buffer ? buffer->contents() : QByteArray();
+}
+
+OutputBuffer *ApplicationOutput::buffer(const QString &appId)
+{
+    auto *buffer = m_buffers.value(appId);
+    if (buffer)
+        return buffer;
+
+    // Make room dropping the buffer that was written least recently,
+    // even if its application is still running, memory is capped anyway
+    if (m_buffers.size() >= maxBuffers) {
+        QString oldest;
+        qint64 oldestWrite = 0;
+        for (auto it = m_buffers.constBegin(); it != m_buffers.constEnd(); ++it) {
+            if (oldest.isEmpty() || it.value()->lastWrite() < oldestWrite) {
+                oldest = it.key();
+                oldestWrite = it.value()->lastWrite();
+            }
+        }
+        if (!oldest.isEmpty())
+            delete m_buffers.take(oldest);
+    }
+
+    buffer = new OutputBuffer(bufferCapacity);
+    m_buffers.insert(appId, buffer);
+    return buffer;
+}
+
+void ApplicationOutput::handleStream(int fd)
+{
+    auto *stream = m_streams.value(fd);
+    if (!stream)
+        return;
+
+    auto *buffer = this->buffer(stream->appId);
+
+    for (int i = 0; i < maxChunks; ++i) {
+        ssize_t size;
+        do {
+            size = ::tee(stream->fd, m_teePipe[1], chunkSize, SPLICE_F_NONBLOCK);
+        } while (size < 0 && errno == EINTR);
+
+        if (size < 0 && errno == EAGAIN)
+            return;
+        if (size <= 0) {
+            // All processes that had the pipe are gone
+            closeStream(stream);
+            return;
+        }
+
+        // Only what reached the output is kept, the rest is still in
+        // the pipe of the application and will be copied again
+        const qsizetype forwarded = forward(stream->fd, stream->outputFd, size);
+        const int error = errno;
+        if (forwarded > 0)
+            buffer->appendFromPipe(m_teePipe[0], forwarded);
+        skip(m_teePipe[0], size);
+
+        if (forwarded < size) {
+            if (error == EAGAIN) {
+                stream->notifier->setEnabled(false);
+                stream->outputNotifier->setEnabled(true);
+                return;
+            }
+
+            // The journal went away, keep only the buffer from now on
+            qCWarning(lcSession, "Failed to forward output of \"%s\": %s",
+                      qPrintable(stream->appId), strerror(error));
+            closeOutput(stream);
+        }
+    }
+}
+
+void ApplicationOutput::closeStream(Stream *stream)
+{
+    m_streams.remove(stream->fd);
+
+    stream->notifier->setEnabled(false);
+    stream->notifier->deleteLater();
+    ::close(stream->fd);
+    closeOutput(stream);
+
+    delete stream;
+}
+
+void ApplicationOutput::closeOutput(Stream *stream)
+{
+    if (stream->outputNotifier) {
+        stream->outputNotifier->setEnabled(false);
+        stream->outputNotifier->deleteLater();
+        stream->outputNotifier = nullptr;
+    }
+
+    if (stream->outputFd >= 0) {
+        ::close(stream->outputFd);
+        stream->outputFd = -1;
+    }
+}
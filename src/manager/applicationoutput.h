@@ -0,0 +1,91 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef APPLICATIONOUTPUT_H
+#define APPLICATIONOUTPUT_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+
+#include <libjournalstream/journalstream.h>
+
+class QSocketNotifier;
+
+/*
+ * Ring buffer with the most recent output of an application.
+ *
+ * Data lives in a sealed memfd, that can't grow beyond its capacity, and
+ * is written there by the kernel with splice(), so that it never passes
+ * through our memory until it's asked for.
+ */
+class OutputBuffer
+{
+public:
+    explicit OutputBuffer(int capacity);
+    ~OutputBuffer();
+
+    bool isValid() const;
+
+    // Moves size bytes from a pipe into the buffer
+    bool appendFromPipe(int pipeFd, qsizetype size);
+
+    QByteArray contents() const;
+
+    qint64 lastWrite() const;
+
+private:
+    int m_fd = -1;
+    int m_capacity = 0;
+    // Bytes ever written, the buffer has the last "capacity" of them
+    quint64 m_written = 0;
+    QElapsedTimer m_lastWriteTimer;
+};
+
+/*
+ * Collects output of launched applications.
+ *
+ * Applications write to a pipe, output is moved from there to the journal
+ * (or to our stderr when journald is not running) and a copy is kept in
+ * the buffer of the application, all with tee() and splice().
+ *
+ * Unlike writing to the journal directly, output goes through our event
+ * loop: that's the price of the buffer, as the journal can't be read back
+ * cheaply. Nothing is dropped when the journal is slow, the application
+ * waits for it like it would anyway, and pipes are large enough to
+ * absorb a busy session manager for a while.
+ */
+class ApplicationOutput : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ApplicationOutput(QObject *parent = nullptr);
+    ~ApplicationOutput();
+
+    // Returns the write end of a pipe for the child, the caller
+    // must close it once the child is started
+    int openStream(const QString &appId, JournalStream::Priority priority);
+
+    QByteArray recentOutput(const QString &appId) const;
+
+private:
+    struct Stream {
+        QString appId;
+        int fd = -1;
+        int outputFd = -1;
+        QSocketNotifier *notifier = nullptr;
+        QSocketNotifier *outputNotifier = nullptr;
+    };
+
+    int m_teePipe[2] = { -1, -1 };
+    QHash<int, Stream *> m_streams;
+    QHash<QString, OutputBuffer *> m_buffers;
+
+    OutputBuffer *buffer(const QString &appId);
+    void handleStream(int fd);
+    void closeStream(Stream *stream);
+    void closeOutput(Stream *stream);
+};
+
+#endif // APPLICATIONOUTPUT_H
@@ -0,0 +1,409 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QDir>
+#include <QFile>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QVector>
+
+#include <libpidfd/pidfd.h>
+
+#include "childsupervisor.h"
+#include "session.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+// Orphans that are zombies for this long are reaped, in milliseconds
+static const int sweepInterval = 10 * 1000;
+
+ChildSupervisor::ChildSupervisor(QObject *parent)
+    : QObject(parent)
+{
+    // Processes that are detached from their parent are reparented to
+    // us instead of init, so they end up in the session scope
+    if (::prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0) < 0)
+        qCWarning(lcSession, "Failed to become a child subreaper: %s",
+                  strerror(errno));
+
+    // All pidfds are watched by a single epoll instance
+    m_epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFd < 0) {
+        qCWarning(lcSession, "Failed to create epoll instance: %s",
+                  strerror(errno));
+    } else {
+        m_notifier = new QSocketNotifier(m_epollFd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated,
+                this, &ChildSupervisor::handleEvents);
+    }
+
+    m_sweepTimer = new QTimer(this);
+    m_sweepTimer->setInterval(sweepInterval);
+    connect(m_sweepTimer, &QTimer::timeout,
+            this, &ChildSupervisor::sweepOrphans);
+    m_sweepTimer->start();
+}
+
+ChildSupervisor::~ChildSupervisor()
+{
+    // Children keep running, we just stop watching them, except those
+    // that are still on hold which quit as soon as the gate is closed
+    for (const auto &child : qAsConst(m_children))
+        ::close(child.pidfd);
+    for (const auto &child : qAsConst(m_heldChildren)) {
+        ::close(child.gateFd);
+        ::close(child.errorFd);
+    }
+
+    if (m_notifier)
+        m_notifier->setEnabled(false);
+    if (m_epollFd >= 0)
+        ::close(m_epollFd);
+}
+
+qint64 ChildSupervisor::spawn(const QStringList &arguments, SpawnMode mode,
+                              int stdoutFd, int stderrFd)
+{
+    if (arguments.isEmpty())
+        return -1;
+
+    const auto program = QStandardPaths::findExecutable(arguments.first());
+    if (program.isEmpty()) {
+        qCWarning(lcSession, "Cannot find program \"%s\"",
+                  qPrintable(arguments.first()));
+        return -1;
+    }
+
+    // Prepare everything before forking, the child can only
+    // make async-signal-safe calls
+    const QByteArray path = QFile::encodeName(program);
+    QVector<QByteArray> args;
+    args.reserve(arguments.size());
+    for (const auto &arg : arguments)
+        args.append(arg.toLocal8Bit());
+    QVector<char *> argv;
+    argv.reserve(args.size() + 1);
+    for (auto &arg : args)
+        argv.append(arg.data());
+    argv.append(nullptr);
+
+    // The pipe is closed on exec, otherwise the child writes errno
+    int errorPipe[2];
+    if (::pipe2(errorPipe, O_CLOEXEC) < 0) {
+        qCWarning(lcSession, "Failed to create pipe: %s", strerror(errno));
+        return -1;
+    }
+
+    // The child waits for a byte on this pipe before executing
+    // the program, or quits when it's closed
+    int gatePipe[2] = { -1, -1 };
+    if (mode == HoldBeforeExec && ::pipe2(gatePipe, O_CLOEXEC) < 0) {
+        qCWarning(lcSession, "Failed to create pipe: %s", strerror(errno));
+        ::close(errorPipe[0]);
+        ::close(errorPipe[1]);
+        return -1;
+    }
+
+    const pid_t pid = ::fork();
+    if (pid < 0) {
+        qCWarning(lcSession, "Failed to fork: %s", strerror(errno));
+        ::close(errorPipe[0]);
+        ::close(errorPipe[1]);
+        if (mode == HoldBeforeExec) {
+            ::close(gatePipe[0]);
+            ::close(gatePipe[1]);
+        }
+        return -1;
+    }
+
+    if (pid == 0) {
+        ::close(errorPipe[0]);
+
+        // Don't pass our signal setup down, this is done before waiting
+        // so that a child on hold can be terminated without our handlers
+        // for SIGTERM and SIGINT running in it
+        sigset_t mask;
+        ::sigemptyset(&mask);
+        ::sigprocmask(SIG_SETMASK, &mask, nullptr);
+        struct sigaction action;
+        ::memset(&action, 0, sizeof(action));
+        action.sa_handler = SIG_DFL;
+        ::sigaction(SIGPIPE, &action, nullptr);
+        ::sigaction(SIGTERM, &action, nullptr);
+        ::sigaction(SIGINT, &action, nullptr);
+
+        if (mode == HoldBeforeExec) {
+            ::close(gatePipe[1]);
+
+            char byte;
+            ssize_t size;
+            do {
+                size = ::read(gatePipe[0], &byte, 1);
+            } while (size < 0 && errno == EINTR);
+            if (size != 1)
+                ::_exit(127);
+        }
+
+        // Descriptors are duplicated without close-on-exec
+        if (stdoutFd >= 0)
+            ::dup2(stdoutFd, STDOUT_FILENO);
+        if (stderrFd >= 0)
+            ::dup2(stderrFd, STDERR_FILENO);
+
+        ::setsid();
+        ::execve(path.constData(), argv.data(), environ);
+
+        const int error = errno;
+        while (::write(errorPipe[1], &error, sizeof(error)) < 0 && errno == EINTR)
+            ;
+        ::_exit(127);
+    }
+
+    ::close(errorPipe[1]);
+
+    if (mode == HoldBeforeExec) {
+        ::close(gatePipe[0]);
+
+        HeldChild heldChild;
+        heldChild.gateFd = gatePipe[1];
+        heldChild.errorFd = errorPipe[0];
+        heldChild.program = path;
+        m_heldChildren.insert(pid, heldChild);
+    } else if (!waitForExec(pid, errorPipe[0], path)) {
+        return -1;
+    }
+
+    Child child;
+    child.pid = pid;
+    child.program = path;
+    child.pidfd = Pidfd::open(pid);
+
+    // Without pidfd support the child is reaped by the orphans sweep
+    if (child.pidfd < 0 || !watchChild(child)) {
+        qCDebug(lcSession, "Cannot watch \"%s\" (pid %d), it will be reaped later",
+                path.constData(), pid);
+        if (child.pidfd >= 0)
+            ::close(child.pidfd);
+        m_unwatchedChildren.insert(pid, path);
+    }
+
+    return pid;
+}
+
+bool ChildSupervisor::release(qint64 pid)
+{
+    auto it = m_heldChildren.find(static_cast<pid_t>(pid));
+    if (it == m_heldChildren.end())
+        return false;
+
+    const auto heldChild = it.value();
+    m_heldChildren.erase(it);
+
+    const char byte = 0;
+    ssize_t size;
+    do {
+        size = ::write(heldChild.gateFd, &byte, 1);
+    } while (size < 0 && errno == EINTR);
+    ::close(heldChild.gateFd);
+
+    return waitForExec(static_cast<pid_t>(pid), heldChild.errorFd, heldChild.program);
+}
+
+bool ChildSupervisor::cancel(qint64 pid)
+{
+    auto it = m_heldChildren.find(static_cast<pid_t>(pid));
+    if (it == m_heldChildren.end())
+        return false;
+
+    // The child quits as soon as the gate is closed
+    ::close(it->gateFd);
+    ::close(it->errorFd);
+    m_heldChildren.erase(it);
+
+    return true;
+}
+
+bool ChildSupervisor::sendSignal(qint64 pid, int signum)
+{
+    for (const auto &child : qAsConst(m_children)) {
+        if (child.pid == static_cast<pid_t>(pid))
+            return Pidfd::sendSignal(child.pidfd, signum) == 0;
+    }
+
+    // Children without a pidfd can't be recycled until they are reaped
+    // by the sweep, which forgets them, any other pid might be reused
+    if (m_unwatchedChildren.contains(static_cast<pid_t>(pid)))
+        return ::kill(static_cast<pid_t>(pid), signum) == 0;
+
+    return false;
+}
+
+bool ChildSupervisor::waitForExec(pid_t pid, int errorFd, const QByteArray &program)
+{
+    // Returns as soon as the program is executed, because
+    // the write end of the pipe is closed on exec
+    int error = 0;
+    ssize_t size;
+    do {
+        size = ::read(errorFd, &error, sizeof(error));
+    } while (size < 0 && errno == EINTR);
+    ::close(errorFd);
+
+    if (size == sizeof(error)) {
+        qCWarning(lcSession, "Failed to execute \"%s\": %s",
+                  program.constData(), strerror(error));
+        ::waitpid(pid, nullptr, 0);
+
+        // Released children are already known to the caller
+        if (m_unwatchedChildren.remove(pid) > 0)
+            Q_EMIT childExited(pid, 127, QProcess::NormalExit);
+        return false;
+    }
+
+    return true;
+}
+
+bool ChildSupervisor::watchChild(const Child &child)
+{
+    if (m_epollFd < 0)
+        return false;
+
+    struct epoll_event event;
+    ::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = child.pidfd;
+    if (::epoll_ctl(m_epollFd, EPOLL_CTL_ADD, child.pidfd, &event) < 0) {
+        qCWarning(lcSession, "Failed to watch pid %d: %s",
+                  child.pid, strerror(errno));
+        return false;
+    }
+
+    m_children.insert(child.pidfd, child);
+    return true;
+}
+
+void ChildSupervisor::reapChild(const Child &child)
+{
+    ::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, child.pidfd, nullptr);
+    ::close(child.pidfd);
+
+    int status = 0;
+    pid_t result;
+    do {
+        result = ::waitpid(child.pid, &status, WNOHANG);
+    } while (result < 0 && errno == EINTR);
+
+    // Already reaped because it failed to execute the program
+    if (result < 0 && errno == ECHILD) {
+        Q_EMIT childExited(child.pid, 127, QProcess::NormalExit);
+        return;
+    }
+    if (result <= 0)
+        return;
+
+    notifyExit(child.pid, child.program, status);
+}
+
+void ChildSupervisor::notifyExit(pid_t pid, const QByteArray &program, int status)
+{
+    if (WIFSIGNALED(status)) {
+        qCWarning(lcSession, "Program \"%s\" (pid %d) crashed with signal %d",
+                  program.constData(), pid, WTERMSIG(status));
+        Q_EMIT childExited(pid, -1, QProcess::CrashExit);
+    } else {
+        const int exitCode = WEXITSTATUS(status);
+        if (exitCode != 0)
+            qCWarning(lcSession, "Program \"%s\" (pid %d) finished with exit code %d",
+                      program.constData(), pid, exitCode);
+        Q_EMIT childExited(pid, exitCode, QProcess::NormalExit);
+    }
+}
+
+void ChildSupervisor::handleEvents()
+{
+    struct epoll_event events[16];
+
+    forever {
+        const int count = ::epoll_wait(m_epollFd, events, 16, 0);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            break;
+
+        for (int i = 0; i < count; ++i) {
+            const auto child = m_children.take(events[i].data.fd);
+            if (child.pidfd >= 0)
+                reapChild(child);
+        }
+    }
+}
+
+void ChildSupervisor::sweepOrphans()
+{
+    // Children we don't supervise include orphans reparented to us and
+    // those started by QProcess: only reap zombies that were already
+    // found by the previous sweep, QProcess reaps its own immediately
+    QSet<pid_t> supervised;
+    for (const auto &child : qAsConst(m_children))
+        supervised.insert(child.pid);
+
+    QSet<pid_t> zombies;
+
+    QDir taskDir(QStringLiteral("/proc/self/task"));
+    const auto tasks = taskDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const auto &task : tasks) {
+        QFile childrenFile(taskDir.absoluteFilePath(task + QStringLiteral("/children")));
+        if (!childrenFile.open(QFile::ReadOnly))
+            continue;
+
+        const auto pids = childrenFile.readAll().split(' ');
+        for (const auto &pidString : pids) {
+            bool ok = false;
+            const pid_t pid = pidString.trimmed().toInt(&ok);
+            if (!ok || supervised.contains(pid))
+                continue;
+
+            // Our own children are reaped right away, and the exit is
+            // notified as if we were watching them
+            auto unwatched = m_unwatchedChildren.find(pid);
+            if (unwatched != m_unwatchedChildren.end()) {
+                int status = 0;
+                if (::waitpid(pid, &status, WNOHANG) == pid) {
+                    const auto program = unwatched.value();
+                    m_unwatchedChildren.erase(unwatched);
+                    notifyExit(pid, program, status);
+                }
+                continue;
+            }
+
+            // The state follows the command name, which is in parentheses
+            QFile statFile(QStringLiteral("/proc/%1/stat").arg(pid));
+            if (!statFile.open(QFile::ReadOnly))
+                continue;
+            const auto stat = statFile.readAll();
+            const int index = stat.lastIndexOf(')');
+            if (index < 0 || index + 2 >= stat.size() || stat.at(index + 2) != 'Z')
+                continue;
+
+            if (m_zombies.contains(pid)) {
+                qCDebug(lcSession, "Reaping orphan process %d", pid);
+                ::waitpid(pid, nullptr, WNOHANG);
+            } else {
+                zombies.insert(pid);
+            }
+        }
+    }
+
+    m_zombies = zombies;
+}
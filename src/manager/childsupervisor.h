@@ -0,0 +1,70 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef CHILDSUPERVISOR_H
+#define CHILDSUPERVISOR_H
+
+#include <QHash>
+#include <QObject>
+#include <QProcess>
+#include <QSet>
+
+class QSocketNotifier;
+class QTimer;
+
+class ChildSupervisor : public QObject
+{
+    Q_OBJECT
+public:
+    enum SpawnMode {
+        // Execute the program right away
+        StartImmediately,
+        // Wait for release() before executing the program
+        HoldBeforeExec
+    };
+
+    explicit ChildSupervisor(QObject *parent = nullptr);
+    ~ChildSupervisor();
+
+    // Output goes where ours goes, unless other descriptors are passed
+    qint64 spawn(const QStringList &arguments, SpawnMode mode = StartImmediately,
+                 int stdoutFd = -1, int stderrFd = -1);
+    bool release(qint64 pid);
+    bool cancel(qint64 pid);
+    bool sendSignal(qint64 pid, int signum);
+
+Q_SIGNALS:
+    void childExited(qint64 pid, int exitCode, QProcess::ExitStatus exitStatus);
+
+private:
+    struct Child {
+        pid_t pid = 0;
+        int pidfd = -1;
+        QByteArray program;
+    };
+
+    struct HeldChild {
+        int gateFd = -1;
+        int errorFd = -1;
+        QByteArray program;
+    };
+
+    int m_epollFd = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QHash<int, Child> m_children;
+    QHash<pid_t, HeldChild> m_heldChildren;
+    // Children without a pidfd, by pid, reaped by the sweep
+    QHash<pid_t, QByteArray> m_unwatchedChildren;
+    QTimer *m_sweepTimer = nullptr;
+    QSet<pid_t> m_zombies;
+
+    bool waitForExec(pid_t pid, int errorFd, const QByteArray &program);
+    bool watchChild(const Child &child);
+    void reapChild(const Child &child);
+    void notifyExit(pid_t pid, const QByteArray &program, int status);
+    void handleEvents();
+    void sweepOrphans();
+};
+
+#endif // CHILDSUPERVISOR_H
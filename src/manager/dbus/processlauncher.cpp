@@ -25,19 +25,119 @@
 #include <QDBusError>
 #include <QFile>
 #include <QFileInfo>
-#include <QRegularExpression>
-#include <QStandardPaths>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QTimer>
 
 #include <LiriXdg/AutoStart>
 #include <LiriXdg/DesktopFile>
 
+#include "applicationindex.h"
+#include "applicationoutput.h"
+#include "childsupervisor.h"
 #include "dbus/processlauncher.h"
+#include "launchhistory.h"
 #include "session.h"
+#include "systemdmanager.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+// How often programs that are starting are checked, in milliseconds
+static const int startupCheckInterval = 100;
+
+// Programs that are still busy after this amount of milliseconds
+// are considered started anyway
+static const int startupTimeout = 5000;
+
+// Programs are started when their first window is shown; those that
+// didn't show one after this amount of milliseconds, like daemons or
+// programs whose windows are not reported, are checked for being idle
+static const int startupWindowTimeout = 2000;
+
+// Consecutive checks a program must be sleeping for, to be considered started
+static const int startupIdleSamples = 5;
+
+// Programs still waiting for their scope after this amount of
+// milliseconds are executed anyway
+static const int scopeTimeout = 5000;
+
+// How long programs have to quit before they are killed, in milliseconds,
+// unless overridden by $LIRI_SESSION_LAUNCHER_GRACE_PERIOD
+static const int defaultGracePeriod = 2000;
+
+// Replies to termination requests are sent this amount of milliseconds
+// after the programs were killed, even if they are not known to be gone
+static const int killTimeout = 1000;
+
+// Most launched applications read ahead at login, unless
+// overridden by $LIRI_SESSION_READAHEAD_APPS
+static const int defaultReadaheadApps = 5;
 
 ProcessLauncher::ProcessLauncher(QObject *parent)
     : QObject(parent)
     , m_session(qobject_cast<Session *>(parent))
+    , m_supervisor(new ChildSupervisor(this))
+    , m_applications(new ApplicationIndex(this))
+    , m_output(new ApplicationOutput(this))
+    , m_history(new LaunchHistory(this))
+    , m_gracePeriod(defaultGracePeriod)
 {
+    bool ok = false;
+    const int gracePeriod = qEnvironmentVariableIntValue("LIRI_SESSION_LAUNCHER_GRACE_PERIOD", &ok);
+    if (ok && gracePeriod >= 0)
+        m_gracePeriod = gracePeriod;
+
+    // A single timer for all the programs that are terminating
+    m_gracePeriodTimer = new QTimer(this);
+    m_gracePeriodTimer->setSingleShot(true);
+    connect(m_gracePeriodTimer, &QTimer::timeout,
+            this, &ProcessLauncher::handleGracePeriodTimeout);
+
+    // Termination requests are not left waiting forever
+    m_terminationTimer = new QTimer(this);
+    m_terminationTimer->setSingleShot(true);
+    connect(m_terminationTimer, &QTimer::timeout,
+            this, &ProcessLauncher::handleTerminationTimeout);
+
+    // A single timer for all the programs waiting for their scope, in
+    // case systemd never tells us about it
+    m_scopeTimer = new QTimer(this);
+    m_scopeTimer->setSingleShot(true);
+    connect(m_scopeTimer, &QTimer::timeout,
+            this, &ProcessLauncher::handleScopeTimeout);
+
+    // Resource controls of the scopes
+    m_resourcePolicy.load();
+
+    // Desktop files were added, removed or modified
+    connect(m_applications, &ApplicationIndex::changed, this, [this] {
+        m_desktopEntries.invalidate();
+    });
+
+    // Programs without a window are started when they are done
+    // with their initialization and are waiting for something to do
+    m_startupTimer = new QTimer(this);
+    m_startupTimer->setInterval(startupCheckInterval);
+    connect(m_startupTimer, &QTimer::timeout,
+            this, &ProcessLauncher::checkStartup);
+
+    // Forget about instances that are gone
+    connect(m_supervisor, &ChildSupervisor::childExited, this, [this](qint64 pid) {
+        const quint64 id = m_instancesByPid.take(pid);
+        auto it = m_instances.find(id);
+        if (it == m_instances.end())
+            return;
+
+        it->exited = true;
+        finishStartup(it.value());
+
+        // Wrappers and single instance launchers quit right away, while
+        // what they started keeps running in the scope until it's removed
+        if (!it->unit.isEmpty() && !it->held)
+            return;
+        removeInstance(id);
+    });
 }
 
 ProcessLauncher::~ProcessLauncher()
@@ -79,45 +179,17 @@ bool ProcessLauncher::LaunchApplication(const QString &appId)
     if (appId.isEmpty())
         return false;
 
-    const QString fileName = QStandardPaths::locate(
-                QStandardPaths::ApplicationsLocation,
-                appId + QStringLiteral(".desktop"));
+    const QString fileName = m_applications->fileName(appId);
     if (fileName.isEmpty()) {
         qCWarning(lcSession) << "Cannot find" << appId << "desktop file";
         return false;
     }
 
-    auto *desktop = Liri::DesktopFileCache::getFile(fileName);
-    if (!desktop) {
-        qCWarning(lcSession) << "No desktop file found for" << appId;
+    if (!launchDesktopFile(appId, fileName, QString(), QStringList()))
         return false;
-    }
 
-    if (m_session->isSystemdEnabled() && !desktop->isDBusActivatable()) {
-        // Run with systemd-run
-        QStringList args = QStringList()
-                << QStringLiteral("--user")
-                << QStringLiteral("--scope")
-                << QStringLiteral("--description=Application %1").arg(appId)
-                << QStringLiteral("--property=Requisite=liri-shell.target")
-                << QStringLiteral("--property=After=liri-shell.target")
-                << QStringLiteral("--property=BindsTo=liri-session.target")
-                << desktop->expandExecString().join(QLatin1Char(' '));
-
-        QProcess *process = new QProcess(this);
-        process->setProgram(QStringLiteral("systemd-run"));
-        process->setArguments(args);
-        connect(process, &QProcess::readyReadStandardOutput,
-                this, &ProcessLauncher::handleReadyReadStandardOutput);
-        connect(process, &QProcess::readyReadStandardError,
-                this, &ProcessLauncher::handleReadyReadStandardError);
-        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                this, &ProcessLauncher::handleProcessFinished);
-        process->start();
-        return process->waitForStarted();
-    } else {
-        return desktop->startDetached();
-    }
+    m_history->recordLaunch(appId);
+    return true;
 }
 
 bool ProcessLauncher::LaunchDesktopFile(const QString &path, const QStringList &urls)
@@ -125,112 +197,578 @@ bool ProcessLauncher::LaunchDesktopFile(const QString &path, const QStringList &
     if (path.isEmpty())
         return false;
 
-    auto *desktop = Liri::DesktopFileCache::getFile(path);
+    const auto appId = id(path);
+    if (!launchDesktopFile(appId, path, path, urls))
+        return false;
+
+    m_history->recordLaunch(appId);
+    return true;
+}
+
+bool ProcessLauncher::LaunchCommand(const QString &command)
+{
+    if (command.isEmpty())
+        return false;
+
+    const auto args = QProcess::splitCommand(command);
+    if (args.isEmpty())
+        return false;
+
+    const auto appId = QFileInfo(args.first()).fileName();
+    if (spawn(appId, QStringLiteral("Run command: %1").arg(command),
+              QString(), args,
+              m_resourcePolicy.properties(appId, QString(), QStringList())) <= 0)
+        return false;
+
+    m_history->recordLaunch(appId);
+    return true;
+}
+
+QList<bool> ProcessLauncher::LaunchDesktopFiles(const QStringList &paths)
+{
+    // Scopes are requested one after the other without waiting,
+    // so the whole batch is created with pipelined calls; these are
+    // autostart entries, which are not part of the launch history
+    QList<bool> results;
+    results.reserve(paths.size());
+    for (const auto &path : paths)
+        results.append(!path.isEmpty() && launchDesktopFile(id(path), path, path, QStringList()));
+    return results;
+}
+
+void ProcessLauncher::prefetchApplications()
+{
+    bool ok = false;
+    int count = qEnvironmentVariableIntValue("LIRI_SESSION_READAHEAD_APPS", &ok);
+    if (!ok || count < 0)
+        count = defaultReadaheadApps;
+
+    if (count > 0)
+        m_history->prefetch(count);
+}
+
+QVariantMap ProcessLauncher::GetLaunchStats()
+{
+    return m_history->statistics();
+}
+
+void ProcessLauncher::ReportFirstWindow(const QString &appId, uint pid)
+{
+    // The window might belong to a child of the program we launched,
+    // in that case the oldest instance still without a window is taken
+    auto it = m_instances.find(m_instancesByPid.value(pid));
+    if (it == m_instances.end() || it->windowShown) {
+        it = m_instances.end();
+        for (auto other = m_instances.begin(); other != m_instances.end(); ++other) {
+            if (other->appId != appId || other->windowShown)
+                continue;
+            if (it == m_instances.end() || other->elapsedTimer.elapsed() > it->elapsedTimer.elapsed())
+                it = other;
+        }
+    }
+    if (it == m_instances.end())
+        return;
+
+    it->windowShown = true;
+    m_history->recordWindowLatency(it->appId, it->elapsedTimer.elapsed());
+
+    // Showing a window is the best sign that it's done initializing
+    finishStartup(it.value());
+}
+
+QByteArray ProcessLauncher::GetRecentOutput(const QString &appId)
+{
+    return m_output->recentOutput(appId);
+}
+
+bool ProcessLauncher::TerminateDesktopFile(const QString &path)
+{
+    return terminateDesktopFiles(QStringList() << path, true).constFirst();
+}
+
+QList<bool> ProcessLauncher::TerminateDesktopFiles(const QStringList &paths)
+{
+    return terminateDesktopFiles(paths, false);
+}
+
+bool ProcessLauncher::launchDesktopFile(const QString &appId, const QString &fileName,
+                                        const QString &sourcePath, const QStringList &urls)
+{
+    // Latencies are measured from here
+    QElapsedTimer launchTimer;
+    launchTimer.start();
+
+    // Use the cache unless we need features that only Liri::DesktopFile
+    // implements, such as D-Bus activation or entries other than applications
+    const auto entry = m_desktopEntries.entryForFile(fileName);
+    if (entry.isValid() && entry.type() == QLatin1String("Application") &&
+            !entry.isDBusActivatable() && !entry.isTerminal() &&
+            entry.workingDirectory().isEmpty()) {
+        const auto command = entry.expandExec(urls);
+        if (command.isEmpty()) {
+            qCWarning(lcSession, "Desktop file \"%s\" has no command to execute",
+                      qPrintable(fileName));
+            return false;
+        }
+
+        const qint64 pid = spawn(appId, QStringLiteral("Application %1").arg(appId),
+                                 sourcePath, command,
+                                 m_resourcePolicy.properties(appId, entry.resourceProfile(),
+                                                             entry.categories()));
+        if (pid < 0)
+            return false;
+
+        addInstance(pid, appId, fileName, launchTimer);
+        return true;
+    }
+
+    auto *desktop = Liri::DesktopFileCache::getFile(fileName);
     if (!desktop) {
-        qCWarning(lcSession) << "Failed to open desktop file" << path;
+        qCWarning(lcSession) << "Failed to open desktop file" << fileName;
         return false;
     }
 
     if (m_session->isSystemdEnabled() && !desktop->isDBusActivatable()) {
-        // Run with systemd-run
-        const QString appId = id(path);
-        QStringList args = QStringList()
-                << QStringLiteral("--user")
-                << QStringLiteral("--scope")
-                << QStringLiteral("--description=Application %1").arg(appId)
-                << QStringLiteral("--property=SourcePath=%1").arg(path)
-                << QStringLiteral("--property=Requisite=liri-shell.target")
-                << QStringLiteral("--property=After=liri-shell.target")
-                << QStringLiteral("--property=BindsTo=liri-session.target")
-                << desktop->expandExecString(urls).join(QLatin1Char(' '));
-
-        QProcess *process = new QProcess(this);
-        process->setProgram(QStringLiteral("systemd-run"));
-        process->setArguments(args);
-        connect(process, &QProcess::readyReadStandardOutput,
-                this, &ProcessLauncher::handleReadyReadStandardOutput);
-        connect(process, &QProcess::readyReadStandardError,
-                this, &ProcessLauncher::handleReadyReadStandardError);
-        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                this, &ProcessLauncher::handleProcessFinished);
-        process->start();
-        return process->waitForStarted();
+        // Run in a transient scope, the cache may still know
+        // which resources the program is entitled to
+        const auto resources = entry.isValid()
+                ? m_resourcePolicy.properties(appId, entry.resourceProfile(), entry.categories())
+                : m_resourcePolicy.properties(appId, QString(), QStringList());
+        const qint64 pid = launchInScope(appId, QStringLiteral("Application %1").arg(appId),
+                                         sourcePath, desktop->expandExecString(urls),
+                                         resources);
+        if (pid < 0)
+            return false;
+
+        addInstance(pid, appId, fileName, launchTimer);
+        return true;
     } else {
-        return desktop->startDetached(urls);
+        // There's no process we can follow
+        if (!desktop->startDetached(urls))
+            return false;
+        Q_EMIT DesktopFileStarted(fileName);
+        return true;
     }
 }
 
-bool ProcessLauncher::LaunchCommand(const QString &command)
+qint64 ProcessLauncher::spawn(const QString &appId, const QString &description,
+                              const QString &sourcePath, const QStringList &command,
+                              const SystemdPropertyList &resources)
 {
-    if (command.isEmpty())
-        return false;
+    // Run in a transient scope, resource controls need one
+    if (m_session->isSystemdEnabled())
+        return launchInScope(appId, description, sourcePath, command, resources);
 
-    if (m_session->isSystemdEnabled()) {
-        // Run with systemd-run
-        QStringList args = QStringList()
-                << QStringLiteral("--user")
-                << QStringLiteral("--scope")
-                << QStringLiteral("--description=Run command: %1").arg(command)
-                << QStringLiteral("--property=Requisite=liri-shell.target")
-                << QStringLiteral("--property=After=liri-shell.target")
-                << QStringLiteral("--property=BindsTo=liri-session.target")
-                << command;
-
-        QProcess *process = new QProcess(this);
-        process->setProgram(QStringLiteral("systemd-run"));
-        process->setArguments(args);
-        connect(process, &QProcess::readyReadStandardOutput,
-                this, &ProcessLauncher::handleReadyReadStandardOutput);
-        connect(process, &QProcess::readyReadStandardError,
-                this, &ProcessLauncher::handleReadyReadStandardError);
-        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                this, &ProcessLauncher::handleProcessFinished);
-        process->start();
-        return process->waitForStarted();
-    } else {
-        QProcess *process = new QProcess(this);
-        return process->startDetached(command);
+    return spawnChild(appId, command, ChildSupervisor::StartImmediately);
+}
+
+qint64 ProcessLauncher::spawnChild(const QString &appId, const QStringList &command,
+                                   ChildSupervisor::SpawnMode mode)
+{
+    // Output goes to the journal tagged with the app ID, and
+    // the most recent of it is kept in memory
+    const int stdoutFd = m_output->openStream(appId, JournalStream::Info);
+    const int stderrFd = m_output->openStream(appId, JournalStream::Warning);
+
+    const qint64 pid = m_supervisor->spawn(command, mode, stdoutFd, stderrFd);
+
+    // The child has its own copies, our ends are closed when it quits
+    if (stdoutFd >= 0)
+        ::close(stdoutFd);
+    if (stderrFd >= 0)
+        ::close(stderrFd);
+
+    return pid;
+}
+
+qint64 ProcessLauncher::launchInScope(const QString &appId, const QString &description,
+                                    const QString &sourcePath, const QStringList &command,
+                                    const SystemdPropertyList &resources)
+{
+    auto *systemd = m_session->systemdManager();
+    if (!m_systemdConnected) {
+        connect(systemd, &SystemdManager::jobFinished,
+                this, &ProcessLauncher::handleJobFinished);
+        connect(systemd, &SystemdManager::unitRemoved,
+                this, &ProcessLauncher::handleUnitRemoved);
+        m_systemdConnected = true;
     }
+
+    // The program is executed only once it's been moved to the
+    // scope, so that everything it spawns ends up there too
+    const qint64 pid = spawnChild(appId, command, ChildSupervisor::HoldBeforeExec);
+    if (pid < 0)
+        return -1;
+
+    const auto unitName = QStringLiteral("app-%1-%2.scope")
+            .arg(escapeUnitName(appId))
+            .arg(QRandomGenerator::global()->generate(), 8, 16, QLatin1Char('0'));
+
+    SystemdPropertyList properties;
+    properties.append({QStringLiteral("Description"), QDBusVariant(description)});
+    if (!sourcePath.isEmpty())
+        properties.append({QStringLiteral("SourcePath"), QDBusVariant(sourcePath)});
+    properties.append({QStringLiteral("PIDs"),
+                       QDBusVariant(QVariant::fromValue(QList<uint>() << uint(pid)))});
+    properties.append({QStringLiteral("Requisite"),
+                       QDBusVariant(QStringList() << QStringLiteral("liri-shell.target"))});
+    properties.append({QStringLiteral("After"),
+                       QDBusVariant(QStringList() << QStringLiteral("liri-shell.target"))});
+    properties.append({QStringLiteral("BindsTo"),
+                       QDBusVariant(QStringList() << QStringLiteral("liri-session.target"))});
+    properties.append(resources);
+
+    HeldChild heldChild;
+    heldChild.unit = unitName;
+    heldChild.elapsedTimer.start();
+    m_pendingScopes.insert(unitName, pid);
+    m_heldChildren.insert(pid, heldChild);
+    if (!m_scopeTimer->isActive())
+        m_scopeTimer->start(scopeTimeout);
+    systemd->startTransientUnit(unitName, QStringLiteral("fail"), properties);
+
+    return pid;
 }
 
-QString ProcessLauncher::id(const QString &fileName) const
+void ProcessLauncher::addInstance(qint64 pid, const QString &appId, const QString &fileName,
+                                  const QElapsedTimer &launchTimer)
+{
+    Instance instance;
+    instance.pid = pid;
+    instance.appId = appId;
+    instance.fileName = fileName;
+    instance.unit = m_heldChildren.value(pid).unit;
+    instance.held = !instance.unit.isEmpty();
+    instance.elapsedTimer = launchTimer;
+    // Programs that don't wait for a scope are already executed
+    if (!instance.held)
+        instance.execLatency = launchTimer.elapsed();
+
+    const quint64 id = ++m_lastInstanceId;
+    m_instances.insert(id, instance);
+    m_instancesByPid.insert(pid, id);
+    if (!instance.unit.isEmpty())
+        m_instancesByUnit.insert(instance.unit, id);
+
+    if (!m_startupTimer->isActive())
+        m_startupTimer->start();
+}
+
+void ProcessLauncher::checkStartup()
+{
+    bool starting = false;
+
+    for (auto it = m_instances.begin(); it != m_instances.end(); ++it) {
+        auto &instance = it.value();
+        if (!instance.starting)
+            continue;
+
+        // Programs waiting for their scope haven't even been executed, and
+        // sleeping programs might just wait for a reply during initialization
+        if (!instance.held && instance.elapsedTimer.hasExpired(startupWindowTimeout)) {
+            // The state follows the command name, which is in parentheses
+            QFile statFile(QStringLiteral("/proc/%1/stat").arg(instance.pid));
+            QByteArray stat;
+            if (statFile.open(QFile::ReadOnly))
+                stat = statFile.readAll();
+            const int index = stat.lastIndexOf(')');
+            const char state = index >= 0 && index + 2 < stat.size() ? stat.at(index + 2) : 'Z';
+
+            if (state == 'S' || state == 'Z' || state == 'T')
+                instance.idleSamples++;
+            else
+                instance.idleSamples = 0;
+        }
+
+        if (instance.idleSamples >= startupIdleSamples ||
+                instance.elapsedTimer.hasExpired(startupTimeout))
+            finishStartup(instance);
+        else
+            starting = true;
+    }
+
+    if (!starting)
+        m_startupTimer->stop();
+}
+
+void ProcessLauncher::removeInstance(quint64 id)
+{
+    auto it = m_instances.find(id);
+    if (it == m_instances.end())
+        return;
+
+    if (m_instancesByPid.value(it->pid) == id)
+        m_instancesByPid.remove(it->pid);
+    if (!it->unit.isEmpty() && m_instancesByUnit.value(it->unit) == id)
+        m_instancesByUnit.remove(it->unit);
+    m_instances.erase(it);
+
+    finishTerminations();
+}
+
+void ProcessLauncher::finishStartup(Instance &instance)
 {
-    const QFileInfo info(fileName);
+    if (!instance.starting)
+        return;
 
-    QRegularExpression suffixRx(QStringLiteral(".desktop$"));
-    QLatin1Char slashChar('/');
-    QLatin1Char dashChar('-');
+    instance.starting = false;
+    qCDebug(lcSession, "Program \"%s\" (pid %lld) started in %lld ms",
+            qPrintable(instance.fileName), instance.pid, instance.elapsedTimer.elapsed());
 
-    QString id = info.canonicalFilePath();
-    id.replace(info.canonicalPath(), QString());
-    if (id.startsWith(slashChar))
-        id.remove(0, 1);
-    id.replace(slashChar, dashChar);
-    id.replace(suffixRx, QString());
+    // Now that it's initialized, it has mapped what it needs
+    m_history->recordFiles(instance.appId, instance.pid);
+    if (instance.execLatency >= 0)
+        m_history->recordExecLatency(instance.appId, instance.execLatency);
+    Q_EMIT DesktopFileStarted(instance.fileName);
+}
+
+QList<bool> ProcessLauncher::terminateDesktopFiles(const QStringList &fileNames, bool single)
+{
+    // All programs are asked to quit at the same time
+    QList<bool> results;
+    results.reserve(fileNames.size());
+    bool terminating = false;
+    for (const auto &fileName : fileNames) {
+        const bool result = !fileName.isEmpty() && terminateDesktopFile(fileName);
+        results.append(result);
+        terminating = terminating || result;
+    }
+
+    // Reply when they are all gone, so that callers know when
+    // teardown is complete
+    if (terminating && calledFromDBus()) {
+        setDelayedReply(true);
+
+        PendingTermination termination;
+        termination.message = message();
+        termination.fileNames = fileNames;
+        if (single)
+            termination.arguments.append(results.constFirst());
+        else
+            termination.arguments.append(QVariant::fromValue(results));
+        termination.elapsedTimer.start();
+        m_pendingTerminations.append(termination);
+
+        if (!m_terminationTimer->isActive())
+            m_terminationTimer->start(m_gracePeriod + killTimeout);
+    }
 
-    return id;
+    return results;
 }
 
-void ProcessLauncher::handleReadyReadStandardOutput()
+bool ProcessLauncher::terminateDesktopFile(const QString &fileName)
 {
-    auto *process = qobject_cast<QProcess *>(sender());
-    if (process)
-        qCInfo(lcSession) << process->readAllStandardOutput().constData();
+    bool found = false;
+
+    for (auto it = m_instances.begin(); it != m_instances.end(); ++it) {
+        auto &instance = it.value();
+        if (instance.fileName != fileName)
+            continue;
+
+        found = true;
+        if (instance.terminating)
+            continue;
+
+        instance.terminating = true;
+        instance.terminationTimer.start();
+
+        // Programs still waiting for their scope are never executed
+        if (instance.held) {
+            m_pendingScopes.remove(instance.unit);
+            m_heldChildren.remove(instance.pid);
+            m_instancesByUnit.remove(instance.unit);
+            instance.unit.clear();
+            instance.held = false;
+            m_supervisor->cancel(instance.pid);
+            continue;
+        }
+
+        qCDebug(lcSession, "Terminating \"%s\" (pid %lld)",
+                qPrintable(fileName), instance.pid);
+        terminateInstance(instance, SIGTERM);
+    }
+
+    if (found && !m_gracePeriodTimer->isActive())
+        m_gracePeriodTimer->start(m_gracePeriod);
+
+    return found;
 }
 
-void ProcessLauncher::handleReadyReadStandardError()
+void ProcessLauncher::terminateInstance(Instance &instance, int signum)
 {
-    auto *process = qobject_cast<QProcess *>(sender());
-    if (process)
-        qCWarning(lcSession) << process->readAllStandardError().constData();
+    // The whole scope is signalled, including processes that
+    // were started by the program
+    if (!instance.unit.isEmpty() && m_session->isSystemdEnabled())
+        m_session->systemdManager()->killUnit(instance.unit, QStringLiteral("all"), signum);
+    else if (!instance.exited)
+        m_supervisor->sendSignal(instance.pid, signum);
 }
 
-void ProcessLauncher::handleProcessFinished(int exitCode, QProcess::ExitStatus exitStatus)
+void ProcessLauncher::handleGracePeriodTimeout()
+{
+    qint64 next = -1;
+
+    for (auto it = m_instances.begin(); it != m_instances.end(); ++it) {
+        auto &instance = it.value();
+        if (!instance.terminating || instance.killed)
+            continue;
+
+        const qint64 remaining = m_gracePeriod - instance.terminationTimer.elapsed();
+        if (remaining <= 0) {
+            qCWarning(lcSession, "Program \"%s\" (pid %lld) didn't quit in time, killing it",
+                      qPrintable(instance.fileName), instance.pid);
+            instance.killed = true;
+            terminateInstance(instance, SIGKILL);
+        } else if (next < 0 || remaining < next) {
+            next = remaining;
+        }
+    }
+
+    // Programs that were asked to quit later
+    if (next >= 0)
+        m_gracePeriodTimer->start(static_cast<int>(next));
+}
+
+void ProcessLauncher::finishTerminations()
+{
+    for (auto it = m_pendingTerminations.begin(); it != m_pendingTerminations.end();) {
+        bool done = true;
+        for (const auto &instance : qAsConst(m_instances)) {
+            if (instance.terminating && it->fileNames.contains(instance.fileName)) {
+                done = false;
+                break;
+            }
+        }
+
+        if (done) {
+            QDBusConnection::sessionBus().send(it->message.createReply(it->arguments));
+            it = m_pendingTerminations.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ProcessLauncher::handleTerminationTimeout()
+{
+    const qint64 timeout = m_gracePeriod + killTimeout;
+    qint64 next = -1;
+
+    for (auto it = m_pendingTerminations.begin(); it != m_pendingTerminations.end();) {
+        const qint64 remaining = timeout - it->elapsedTimer.elapsed();
+        if (remaining <= 0) {
+            qCWarning(lcSession, "Programs of %s are not known to be gone, replying anyway",
+                      qPrintable(it->fileNames.join(QStringLiteral(", "))));
+            QDBusConnection::sessionBus().send(it->message.createReply(it->arguments));
+            it = m_pendingTerminations.erase(it);
+        } else {
+            if (next < 0 || remaining < next)
+                next = remaining;
+            ++it;
+        }
+    }
+
+    if (next >= 0)
+        m_terminationTimer->start(static_cast<int>(next));
+}
+
+void ProcessLauncher::handleJobFinished(const QString &unit, const QString &result)
+{
+    if (!m_pendingScopes.contains(unit))
+        return;
+
+    // Better run the program outside of the scope than not at all
+    if (result != QLatin1String("done"))
+        qCWarning(lcSession, "Failed to create scope \"%s\" (%s), running the program anyway",
+                  qPrintable(unit), qPrintable(result));
+
+    releaseHeldChild(unit, result == QLatin1String("done"));
+}
+
+void ProcessLauncher::handleScopeTimeout()
+{
+    qint64 next = -1;
+    QStringList expired;
+
+    for (const auto &heldChild : qAsConst(m_heldChildren)) {
+        const qint64 remaining = scopeTimeout - heldChild.elapsedTimer.elapsed();
+        if (remaining <= 0)
+            expired.append(heldChild.unit);
+        else if (next < 0 || remaining < next)
+            next = remaining;
+    }
+
+    for (const auto &unit : qAsConst(expired)) {
+        qCWarning(lcSession, "Scope \"%s\" wasn't created in time, running the program anyway",
+                  qPrintable(unit));
+        releaseHeldChild(unit, false);
+    }
+
+    if (next >= 0)
+        m_scopeTimer->start(static_cast<int>(next));
+}
+
+void ProcessLauncher::releaseHeldChild(const QString &unit, bool inScope)
+{
+    const qint64 pid = m_pendingScopes.take(unit);
+    m_heldChildren.remove(pid);
+
+    // Programs outside of the scope are signalled directly
+    auto instance = m_instances.find(m_instancesByPid.value(pid));
+    if (instance != m_instances.end()) {
+        instance->held = false;
+        if (!inScope) {
+            m_instancesByUnit.remove(instance->unit);
+            instance->unit.clear();
+        }
+    }
+
+    // Children that fail to execute are notified, and forgotten, right away
+    if (!m_supervisor->release(pid))
+        return;
+
+    instance = m_instances.find(m_instancesByPid.value(pid));
+    if (instance != m_instances.end())
+        instance->execLatency = instance->elapsedTimer.elapsed();
+}
+
+void ProcessLauncher::handleUnitRemoved(const QString &unit)
+{
+    // Everything that was running in the scope is gone
+    const auto it = m_instancesByUnit.constFind(unit);
+    if (it != m_instancesByUnit.constEnd())
+        removeInstance(it.value());
+}
+
+QString ProcessLauncher::escapeUnitName(const QString &name)
+{
+    // Same escaping rules of systemd-escape
+    const auto utf8 = name.toUtf8();
+    QString escaped;
+    escaped.reserve(utf8.size());
+    for (int i = 0; i < utf8.size(); ++i) {
+        const char c = utf8.at(i);
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                c == ':' || c == '_' || (c == '.' && i > 0))
+            escaped.append(QLatin1Char(c));
+        else if (c == '/')
+            escaped.append(QLatin1Char('-'));
+        else
+            escaped.append(QStringLiteral("\\x%1").arg(uint(uchar(c)), 2, 16, QLatin1Char('0')));
+    }
+    return escaped;
+}
+
+QString ProcessLauncher::id(const QString &fileName) const
 {
-    Q_UNUSED(exitCode)
-    Q_UNUSED(exitStatus)
+    // Desktop files outside of the applications directories
+    // are identified by their file name
+    const auto appId = m_applications->appId(fileName);
+    if (!appId.isEmpty())
+        return appId;
 
-    auto *process = qobject_cast<QProcess *>(sender());
-    if (process)
-        process->deleteLater();
+    const auto name = QFileInfo(fileName).fileName();
+    if (name.endsWith(QLatin1String(".desktop")))
+        return name.chopped(8);
+    return name;
 }
@@ -24,12 +24,26 @@
 #ifndef PROCESSLAUNCHER_H
 #define PROCESSLAUNCHER_H
 
+#include <QDBusContext>
+#include <QDBusMessage>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
-#include <QProcess>
+#include <QVariantMap>
+#include <QVector>
 
+#include <libdesktopentrycache/desktopentrycache.h>
+
+#include "childsupervisor.h"
+#include "resourcepolicy.h"
+
+class ApplicationIndex;
+class ApplicationOutput;
+class LaunchHistory;
 class Session;
+class QTimer;
 
-class ProcessLauncher : public QObject
+class ProcessLauncher : public QObject, protected QDBusContext
 {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "io.liri.Launcher")
@@ -39,22 +53,116 @@ public:
 
     bool registerWithDBus();
 
+    void prefetchApplications();
+
     Q_SCRIPTABLE bool LaunchApplication(const QString &appId);
     Q_SCRIPTABLE bool LaunchDesktopFile(const QString &path, const QStringList &urls = QStringList());
     Q_SCRIPTABLE bool LaunchCommand(const QString &command);
 
+    Q_SCRIPTABLE QList<bool> LaunchDesktopFiles(const QStringList &paths);
+
+    Q_SCRIPTABLE bool TerminateDesktopFile(const QString &path);
+    Q_SCRIPTABLE QList<bool> TerminateDesktopFiles(const QStringList &paths);
+
+    Q_SCRIPTABLE QByteArray GetRecentOutput(const QString &appId);
+
+    Q_SCRIPTABLE QVariantMap GetLaunchStats();
+    Q_SCRIPTABLE void ReportFirstWindow(const QString &appId, uint pid);
+
     const QString serviceName = QStringLiteral("io.liri.Launcher");
     const QString objectPath = QStringLiteral("/io/liri/Launcher");
 
+Q_SIGNALS:
+    Q_SCRIPTABLE void DesktopFileStarted(const QString &path);
+
 private:
+    struct Instance {
+        qint64 pid = 0;
+        QString appId;
+        QString fileName;
+        // Transient scope, only with systemd
+        QString unit;
+        // Waiting for the scope before being executed
+        bool held = false;
+        // The program quit, but it might have left processes in its scope
+        bool exited = false;
+        // Milliseconds from the launch request, -1 if not executed yet
+        qint64 execLatency = -1;
+        bool windowShown = false;
+        bool starting = true;
+        int idleSamples = 0;
+        QElapsedTimer elapsedTimer;
+        bool terminating = false;
+        bool killed = false;
+        QElapsedTimer terminationTimer;
+    };
+
+    // Replied to when all instances of the desktop files are gone
+    struct PendingTermination {
+        QDBusMessage message;
+        QStringList fileNames;
+        QVariantList arguments;
+        QElapsedTimer elapsedTimer;
+    };
+
     Session *m_session = nullptr;
+    ChildSupervisor *m_supervisor = nullptr;
+    ApplicationIndex *m_applications = nullptr;
+    ApplicationOutput *m_output = nullptr;
+    LaunchHistory *m_history = nullptr;
+    DesktopEntryCache m_desktopEntries;
+    ResourcePolicy m_resourcePolicy;
+    bool m_systemdConnected = false;
+    // Programs waiting for their transient scope to be created
+    struct HeldChild {
+        QString unit;
+        QElapsedTimer elapsedTimer;
+    };
 
-    QString id(const QString &fileName) const;
+    // Transient scopes being created, by unit name and by pid
+    QHash<QString, qint64> m_pendingScopes;
+    QHash<qint64, HeldChild> m_heldChildren;
+    QTimer *m_scopeTimer = nullptr;
+    // Processes started from desktop files, by ID; those in a scope
+    // are tracked until the scope is gone, not just their main process
+    QHash<quint64, Instance> m_instances;
+    QHash<qint64, quint64> m_instancesByPid;
+    QHash<QString, quint64> m_instancesByUnit;
+    quint64 m_lastInstanceId = 0;
+    QTimer *m_startupTimer = nullptr;
+    int m_gracePeriod;
+    QTimer *m_gracePeriodTimer = nullptr;
+    QVector<PendingTermination> m_pendingTerminations;
+    QTimer *m_terminationTimer = nullptr;
+
+    bool launchDesktopFile(const QString &appId, const QString &fileName,
+                           const QString &sourcePath, const QStringList &urls);
+    qint64 spawn(const QString &appId, const QString &description,
+                 const QString &sourcePath, const QStringList &command,
+                 const SystemdPropertyList &resources);
+    qint64 spawnChild(const QString &appId, const QStringList &command,
+                      ChildSupervisor::SpawnMode mode);
+    qint64 launchInScope(const QString &appId, const QString &description,
+                         const QString &sourcePath, const QStringList &command,
+                         const SystemdPropertyList &resources);
+    void addInstance(qint64 pid, const QString &appId, const QString &fileName,
+                     const QElapsedTimer &launchTimer);
+    void checkStartup();
+    void removeInstance(quint64 id);
+    void finishStartup(Instance &instance);
+    QList<bool> terminateDesktopFiles(const QStringList &fileNames, bool single);
+    bool terminateDesktopFile(const QString &fileName);
+    void terminateInstance(Instance &instance, int signum);
+    void handleGracePeriodTimeout();
+    void finishTerminations();
+    void handleTerminationTimeout();
+    void handleJobFinished(const QString &unit, const QString &result);
+    void handleUnitRemoved(const QString &unit);
+    void handleScopeTimeout();
+    void releaseHeldChild(const QString &unit, bool inScope);
 
-private Q_SLOTS:
-    void handleReadyReadStandardOutput();
-    void handleReadyReadStandardError();
-    void handleProcessFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    static QString escapeUnitName(const QString &name);
+    QString id(const QString &fileName) const;
 };
 
 #endif // PROCESSLAUNCHER_H
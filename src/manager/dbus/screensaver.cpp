@@ -23,13 +23,18 @@
 
 #include <QDBusConnection>
 #include <QDBusError>
+#include <QDBusServiceWatcher>
 
 #include "screensaver.h"
 #include "session.h"
+#include "idletracker.h"
 #include "backends/sessionbackend.h"
 
+#include <limits>
+
 ScreenSaver::ScreenSaver(QObject *parent)
     : QObject(parent)
+    , m_session(qobject_cast<Session *>(parent))
 {
     connect(SessionBackend::instance(), &SessionBackend::sessionLocked,
             this, &ScreenSaver::handleLock);
@@ -37,6 +42,13 @@ ScreenSaver::ScreenSaver(QObject *parent)
             this, &ScreenSaver::handleUnlock);
     connect(SessionBackend::instance(), &SessionBackend::inhibited,
             this, &ScreenSaver::handleInhibited);
+
+    // Clients that quit without calling UnInhibit() lose their inhibitions
+    m_serviceWatcher = new QDBusServiceWatcher(this);
+    m_serviceWatcher->setConnection(QDBusConnection::sessionBus());
+    m_serviceWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+    connect(m_serviceWatcher, &QDBusServiceWatcher::serviceUnregistered,
+            this, &ScreenSaver::handleServiceUnregistered);
 }
 
 ScreenSaver::~ScreenSaver()
@@ -102,13 +114,17 @@ uint ScreenSaver::GetActiveTime()
 
 uint ScreenSaver::GetSessionIdleTime()
 {
-    // TODO:
-    return 0;
+    // Milliseconds, like GetActiveTime()
+    if (!m_session)
+        return 0;
+    const qint64 elapsed = m_session->idleTracker()->idleTime();
+    return elapsed > 0 ? uint(qMin<qint64>(elapsed, std::numeric_limits<uint>::max())) : 0;
 }
 
 void ScreenSaver::SimulateUserActivity()
 {
-    // TODO:
+    if (m_session)
+        m_session->idleTracker()->reportActivity();
 }
 
 uint ScreenSaver::Inhibit(const QString &appName, const QString &reason)
@@ -116,7 +132,12 @@ uint ScreenSaver::Inhibit(const QString &appName, const QString &reason)
     static uint cookieSeed = 0;
     uint newCookie = cookieSeed++;
 
-    m_inhibit[newCookie] = InhibitEntry{ appName, reason };
+    const QString service = calledFromDBus() ? message().service() : QString();
+    m_inhibit[newCookie] = InhibitEntry{ appName, reason, service };
+    if (!service.isEmpty() && !m_serviceWatcher->watchedServices().contains(service))
+        m_serviceWatcher->addWatchedService(service);
+    if (m_session)
+        m_session->idleTracker()->setInhibited(true);
 
     SessionBackend::instance()->inhibitIdle(appName, reason);
 
@@ -125,14 +146,7 @@ uint ScreenSaver::Inhibit(const QString &appName, const QString &reason)
 
 void ScreenSaver::UnInhibit(uint cookie)
 {
-    int fd = m_inhibitFd.value(cookie, -1);
-
-    if (fd != -1) {
-        SessionBackend::instance()->uninhibitIdle(fd);
-
-        m_inhibit.remove(cookie);
-        m_inhibitFd.remove(cookie);
-    }
+    removeInhibition(cookie);
 }
 
 void ScreenSaver::Lock()
@@ -168,13 +182,58 @@ void ScreenSaver::handleUnlock()
     emit ActiveChanged(m_active);
 }
 
+void ScreenSaver::removeInhibition(uint cookie)
+{
+    auto it = m_inhibit.find(cookie);
+    if (it == m_inhibit.end())
+        return;
+
+    const QString service = it.value().service;
+    m_inhibit.erase(it);
+
+    // Not every backend delivers a file descriptor
+    const int fd = m_inhibitFd.value(cookie, -1);
+    m_inhibitFd.remove(cookie);
+    if (fd != -1)
+        SessionBackend::instance()->uninhibitIdle(fd);
+
+    if (!service.isEmpty()) {
+        bool watched = false;
+        for (const auto &entry : qAsConst(m_inhibit)) {
+            if (entry.service == service) {
+                watched = true;
+                break;
+            }
+        }
+        if (!watched)
+            m_serviceWatcher->removeWatchedService(service);
+    }
+
+    if (m_session)
+        m_session->idleTracker()->setInhibited(!m_inhibit.isEmpty());
+}
+
 void ScreenSaver::handleInhibited(const QString &who, const QString &why, int fd)
 {
-    const auto keys = m_inhibit.keys();
-    for (auto cookie : keys) {
-        if (m_inhibit[cookie].who == who && m_inhibit[cookie].why == why) {
-            m_inhibitFd[cookie] = fd;
+    for (auto it = m_inhibit.constBegin(); it != m_inhibit.constEnd(); ++it) {
+        if (it.value().who == who && it.value().why == why && !m_inhibitFd.contains(it.key())) {
+            m_inhibitFd[it.key()] = fd;
             break;
         }
     }
 }
+
+void ScreenSaver::handleServiceUnregistered(const QString &service)
+{
+    QList<uint> cookies;
+    for (auto it = m_inhibit.constBegin(); it != m_inhibit.constEnd(); ++it) {
+        if (it.value().service == service)
+            cookies.append(it.key());
+    }
+
+    for (uint cookie : qAsConst(cookies)) {
+        qCDebug(lcSession, "Removing inhibition %u of \"%s\", that left the bus",
+                cookie, qPrintable(m_inhibit.value(cookie).who));
+        removeInhibition(cookie);
+    }
+}
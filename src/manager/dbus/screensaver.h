@@ -24,16 +24,23 @@
 #ifndef SCREENSAVER_H
 #define SCREENSAVER_H
 
+#include <QDBusContext>
 #include <QElapsedTimer>
 #include <QObject>
 #include <QMap>
 
+class QDBusServiceWatcher;
+
+class Session;
+
 struct InhibitEntry {
     QString who;
     QString why;
+    // Bus name of the client, empty if not called over D-Bus
+    QString service;
 };
 
-class ScreenSaver : public QObject
+class ScreenSaver : public QObject, protected QDBusContext
 {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "org.freedesktop.ScreenSaver")
@@ -66,15 +73,20 @@ Q_SIGNALS:
     Q_SCRIPTABLE void ActiveChanged(bool in);
 
 private:
+    Session *m_session = nullptr;
     bool m_active = false;
     QMap<uint, InhibitEntry> m_inhibit;
     QMap<uint, int> m_inhibitFd;
+    QDBusServiceWatcher *m_serviceWatcher = nullptr;
     QElapsedTimer m_elapsedTimer;
 
+    void removeInhibition(uint cookie);
+
 private Q_SLOTS:
     void handleLock();
     void handleUnlock();
     void handleInhibited(const QString &who, const QString &why, int fd);
+    void handleServiceUnregistered(const QString &service);
 };
 
 #endif // SCREENSAVER_H
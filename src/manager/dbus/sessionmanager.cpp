@@ -24,6 +24,7 @@
 #include <QDBusConnection>
 
 #include "backends/sessionbackend.h"
+#include "idletracker.h"
 #include "session.h"
 #include "sessionmanager.h"
 #include "sessionmanageradaptor.h"
@@ -41,6 +42,9 @@ SessionManager::SessionManager(QObject *parent)
             this, &SessionManager::Locked);
     connect(SessionBackend::instance(), &SessionBackend::sessionUnlocked,
             this, &SessionManager::Unlocked);
+    if (m_session)
+        connect(m_session->idleTracker(), &IdleTracker::idleChanged,
+                this, &SessionManager::IdleChanged);
 }
 
 SessionManager::~SessionManager()
@@ -74,19 +78,49 @@ bool SessionManager::registerWithDBus()
 
 void SessionManager::SetEnvironment(const QString &key, const QString &value)
 {
-    if (m_session)
+    if (m_session) {
         m_session->setEnvironment(key, value);
+        replyAfterEnvironmentUpload();
+    }
+}
+
+void SessionManager::SetEnvironmentBatch(const EnvMap &environment)
+{
+    if (m_session) {
+        m_session->setEnvironmentBatch(environment);
+        replyAfterEnvironmentUpload();
+    }
 }
 
 void SessionManager::UnsetEnvironment(const QString &key)
 {
-    if (m_session)
+    if (m_session) {
         m_session->unsetEnvironment(key);
+        replyAfterEnvironmentUpload();
+    }
+}
+
+void SessionManager::replyAfterEnvironmentUpload()
+{
+    if (!calledFromDBus())
+        return;
+
+    setDelayedReply(true);
+    m_session->replyAfterEnvironmentUpload(message());
 }
 
 void SessionManager::SetIdle(bool idle)
 {
-    SessionBackend::instance()->setIdle(idle);
+    if (m_session)
+        m_session->idleTracker()->setIdle(idle);
+    else
+        SessionBackend::instance()->setIdle(idle);
+}
+
+void SessionManager::ReportActivity()
+{
+    if (m_session)
+        m_session->idleTracker()->reportActivity();
 }
 
 void SessionManager::Lock()
@@ -104,3 +138,10 @@ void SessionManager::Logout()
     if (m_session)
         m_session->shutdown();
 }
+
+TimelineEventList SessionManager::GetStartupTimeline()
+{
+    if (m_session)
+        return m_session->timeline()->events();
+    return TimelineEventList();
+}
@@ -24,12 +24,14 @@
 #ifndef SESSIONMANAGER_H
 #define SESSIONMANAGER_H
 
+#include <QDBusContext>
 #include <QObject>
 #include <QProcess>
 
-class Session;
+#include "session.h"
+#include "timeline.h"
 
-class SessionManager : public QObject
+class SessionManager : public QObject, protected QDBusContext
 {
     Q_OBJECT
 public:
@@ -41,17 +43,23 @@ public:
 Q_SIGNALS:
     void Locked();
     void Unlocked();
+    void IdleChanged(bool idle);
 
 public Q_SLOTS:
     void SetEnvironment(const QString &key, const QString &value);
+    void SetEnvironmentBatch(const EnvMap &environment);
     void UnsetEnvironment(const QString &key);
     void SetIdle(bool idle);
+    void ReportActivity();
     void Lock();
     void Unlock();
     void Logout();
+    TimelineEventList GetStartupTimeline();
 
 private:
     Session *m_session = nullptr;
+
+    void replyAfterEnvironmentUpload();
 };
 
 #endif // SESSIONMANAGER_H
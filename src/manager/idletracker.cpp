@@ -0,0 +1,132 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QTimer>
+
+#include <Qt6GSettings/QGSettings>
+
+#include "backends/sessionbackend.h"
+#include "idletracker.h"
+#include "session.h"
+
+#include <limits>
+
+static const QString idleDelayKey = QStringLiteral("idleDelay");
+
+IdleTracker::IdleTracker(QObject *parent)
+    : QObject(parent)
+{
+    m_lastActivity.start();
+    m_idleCountdown.start();
+
+    // A single deadline for the whole session, which is only moved when
+    // it expires, so reporting activity doesn't touch the timer at all;
+    // precision isn't important here and fewer wakeups save power
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::VeryCoarseTimer);
+    connect(m_timer, &QTimer::timeout,
+            this, &IdleTracker::handleTimeout);
+
+    m_settings = new QtGSettings::QGSettings(
+                QStringLiteral("io.liri.session"),
+                QStringLiteral("/io/liri/session/"),
+                this);
+    connect(m_settings, &QtGSettings::QGSettings::settingChanged,
+            this, &IdleTracker::handleSettingChanged);
+    handleSettingChanged(idleDelayKey);
+}
+
+bool IdleTracker::isIdle() const
+{
+    return m_idle;
+}
+
+void IdleTracker::setIdle(bool value)
+{
+    if (!value) {
+        // Coming back from idle is activity
+        reportActivity();
+        return;
+    }
+
+    if (m_idle)
+        return;
+
+    m_timer->stop();
+    m_idle = true;
+    qCDebug(lcSession, "Session is idle");
+    SessionBackend::instance()->setIdle(true);
+    Q_EMIT idleChanged(true);
+}
+
+void IdleTracker::setInhibited(bool value)
+{
+    if (m_inhibited == value)
+        return;
+
+    m_inhibited = value;
+
+    if (m_inhibited) {
+        // Inhibiting while idle, e.g. starting a video, wakes the session
+        if (m_idle)
+            reportActivity();
+    } else {
+        // The idle delay counts from the end of the inhibition, otherwise
+        // the session would go idle right after a long one
+        m_idleCountdown.restart();
+    }
+
+    scheduleTimeout();
+}
+
+qint64 IdleTracker::idleTime() const
+{
+    return m_lastActivity.elapsed();
+}
+
+void IdleTracker::reportActivity()
+{
+    m_lastActivity.restart();
+    m_idleCountdown.restart();
+
+    if (m_idle) {
+        m_idle = false;
+        qCDebug(lcSession, "Session is no longer idle");
+        SessionBackend::instance()->setIdle(false);
+        Q_EMIT idleChanged(false);
+    }
+
+    if (!m_timer->isActive())
+        scheduleTimeout();
+}
+
+void IdleTracker::scheduleTimeout()
+{
+    if (m_idle || m_inhibited || m_idleDelay == 0) {
+        m_timer->stop();
+        return;
+    }
+
+    const qint64 remaining = qint64(m_idleDelay) * 1000 - m_idleCountdown.elapsed();
+    m_timer->start(int(qBound<qint64>(0, remaining, std::numeric_limits<int>::max())));
+}
+
+void IdleTracker::handleTimeout()
+{
+    // Activity reported in the meantime moves the deadline
+    if (m_idleCountdown.elapsed() >= qint64(m_idleDelay) * 1000)
+        setIdle(true);
+    else
+        scheduleTimeout();
+}
+
+void IdleTracker::handleSettingChanged(const QString &key)
+{
+    if (key != idleDelayKey)
+        return;
+
+    m_idleDelay = m_settings->value(idleDelayKey).toUInt();
+    scheduleTimeout();
+}
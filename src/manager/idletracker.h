@@ -0,0 +1,56 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef IDLETRACKER_H
+#define IDLETRACKER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+
+namespace QtGSettings {
+class QGSettings;
+} // namespace QtGSettings
+
+class QTimer;
+
+/*
+ * Decides when the session is idle, based on the activity reported
+ * by the shell and the idle-delay setting, and tells the session backend.
+ */
+class IdleTracker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit IdleTracker(QObject *parent = nullptr);
+
+    bool isIdle() const;
+    void setIdle(bool value);
+
+    void setInhibited(bool value);
+
+    // Milliseconds since the last activity
+    qint64 idleTime() const;
+
+    void reportActivity();
+
+Q_SIGNALS:
+    void idleChanged(bool idle);
+
+private:
+    QtGSettings::QGSettings *m_settings = nullptr;
+    // Seconds, 0 means the session is never idle
+    uint m_idleDelay = 0;
+    bool m_idle = false;
+    bool m_inhibited = false;
+    QElapsedTimer m_lastActivity;
+    // Since the last activity or the end of the last inhibition
+    QElapsedTimer m_idleCountdown;
+    QTimer *m_timer = nullptr;
+
+    void scheduleTimeout();
+    void handleTimeout();
+    void handleSettingChanged(const QString &key);
+};
+
+#endif // IDLETRACKER_H
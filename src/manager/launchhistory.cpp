@@ -0,0 +1,296 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThread>
+#include <QTimer>
+
+#include "launchhistory.h"
+#include "session.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+static const quint32 HistoryMagic = 0x4c4c4849; // "LLHI"
+static const quint32 HistoryVersion = 2;
+
+// Upper bounds of the latency histogram buckets in milliseconds,
+// the last bucket counts everything slower
+static const QList<uint> latencyBuckets = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000
+};
+
+// Applications that are remembered, the least used are forgotten
+static const int maxEntries = 100;
+
+// Files remembered for each application
+static const int maxFiles = 256;
+
+// Changes are written after this amount of milliseconds
+static const int saveDelay = 5000;
+
+static void prefetchFiles(const QStringList &fileNames)
+{
+    // Don't compete with the programs that are actually starting,
+    // the idle class only uses the disk when nobody else does
+    if (::syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                  IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) < 0)
+        qCDebug(lcSession, "Failed to lower I/O priority for readahead: %s",
+                strerror(errno));
+
+    for (const auto &fileName : fileNames) {
+        const int fd = ::open(QFile::encodeName(fileName).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        ::close(fd);
+    }
+}
+
+LaunchHistory::LaunchHistory(QObject *parent)
+    : QObject(parent)
+{
+    m_saveTimer = new QTimer(this);
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(saveDelay);
+    connect(m_saveTimer, &QTimer::timeout,
+            this, &LaunchHistory::save);
+
+    load();
+}
+
+LaunchHistory::~LaunchHistory()
+{
+    if (m_dirty)
+        save();
+}
+
+void LaunchHistory::recordLaunch(const QString &appId)
+{
+    if (appId.isEmpty())
+        return;
+
+    auto &entry = m_entries[appId];
+    entry.count++;
+    entry.lastLaunch = QDateTime::currentMSecsSinceEpoch();
+
+    if (m_entries.size() > maxEntries) {
+        auto leastUsed = m_entries.end();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if (it.key() == appId)
+                continue;
+            if (leastUsed == m_entries.end() || it->count < leastUsed->count ||
+                    (it->count == leastUsed->count && it->lastLaunch < leastUsed->lastLaunch))
+                leastUsed = it;
+        }
+        m_entries.erase(leastUsed);
+    }
+
+    scheduleSave();
+}
+
+void LaunchHistory::recordFiles(const QString &appId, qint64 pid)
+{
+    auto it = m_entries.find(appId);
+    if (it == m_entries.end())
+        return;
+
+    QFile mapsFile(QStringLiteral("/proc/%1/maps").arg(pid));
+    if (!mapsFile.open(QFile::ReadOnly))
+        return;
+
+    // Each line is "address perms offset dev inode path", the
+    // executable and libraries are the regular files mapped
+    QStringList files;
+    QSet<QString> seen;
+    const auto lines = mapsFile.readAll().split('\n');
+    for (const auto &line : lines) {
+        const int index = line.indexOf(" /");
+        if (index < 0 || line.endsWith(" (deleted)"))
+            continue;
+
+        const auto path = QFile::decodeName(line.mid(index + 1));
+        if (path.startsWith(QLatin1String("/dev/")) || path.startsWith(QLatin1String("/memfd:")) ||
+                seen.contains(path))
+            continue;
+
+        seen.insert(path);
+        files.append(path);
+        if (files.size() >= maxFiles)
+            break;
+    }
+
+    if (files.isEmpty() || files == it->files)
+        return;
+
+    it->files = files;
+    scheduleSave();
+}
+
+void LaunchHistory::recordExecLatency(const QString &appId, qint64 msecs)
+{
+    auto it = m_entries.find(appId);
+    if (it != m_entries.end())
+        recordLatency(it->execLatency, msecs);
+}
+
+void LaunchHistory::recordWindowLatency(const QString &appId, qint64 msecs)
+{
+    auto it = m_entries.find(appId);
+    if (it != m_entries.end())
+        recordLatency(it->windowLatency, msecs);
+}
+
+QStringList LaunchHistory::topApplications(int count) const
+{
+    QStringList appIds = m_entries.keys();
+    std::sort(appIds.begin(), appIds.end(), [this](const QString &a, const QString &b) {
+        const auto &first = *m_entries.constFind(a);
+        const auto &second = *m_entries.constFind(b);
+        if (first.count != second.count)
+            return first.count > second.count;
+        return first.lastLaunch > second.lastLaunch;
+    });
+    return appIds.mid(0, count);
+}
+
+QVariantMap LaunchHistory::statistics() const
+{
+    QVariantMap statistics;
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        QVariantMap entry;
+        entry.insert(QStringLiteral("count"), uint(it->count));
+        entry.insert(QStringLiteral("lastLaunch"), it->lastLaunch);
+        entry.insert(QStringLiteral("latencyBuckets"), QVariant::fromValue(latencyBuckets));
+        entry.insert(QStringLiteral("execLatency"),
+                     QVariant::fromValue(QList<uint>(it->execLatency.cbegin(), it->execLatency.cend())));
+        entry.insert(QStringLiteral("firstWindowLatency"),
+                     QVariant::fromValue(QList<uint>(it->windowLatency.cbegin(), it->windowLatency.cend())));
+        statistics.insert(it.key(), entry);
+    }
+    return statistics;
+}
+
+void LaunchHistory::prefetch(int count)
+{
+    QStringList files;
+    QSet<QString> seen;
+    const auto appIds = topApplications(count);
+    for (const auto &appId : appIds) {
+        const auto &appFiles = m_entries.constFind(appId)->files;
+        for (const auto &fileName : appFiles) {
+            if (!seen.contains(fileName)) {
+                seen.insert(fileName);
+                files.append(fileName);
+            }
+        }
+    }
+
+    if (files.isEmpty())
+        return;
+
+    qCDebug(lcSession, "Reading ahead %d files of %d applications",
+            int(files.size()), int(appIds.size()));
+
+    auto *thread = QThread::create(prefetchFiles, files);
+    thread->setObjectName(QStringLiteral("Readahead"));
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    thread->start(QThread::IdlePriority);
+}
+
+QString LaunchHistory::historyFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+            QStringLiteral("/liri-session/launch-history");
+}
+
+void LaunchHistory::load()
+{
+    QFile file(historyFileName());
+    if (!file.open(QFile::ReadOnly))
+        return;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    // Version 1 had no latencies
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != HistoryMagic || version < 1 || version > HistoryVersion)
+        return;
+
+    quint32 size = 0;
+    stream >> size;
+    for (quint32 i = 0; i < size && stream.status() == QDataStream::Ok; ++i) {
+        QString appId;
+        Entry entry;
+        stream >> appId >> entry.count >> entry.lastLaunch >> entry.files;
+        if (version >= 2)
+            stream >> entry.execLatency >> entry.windowLatency;
+        if (stream.status() == QDataStream::Ok)
+            m_entries.insert(appId, entry);
+    }
+}
+
+void LaunchHistory::save()
+{
+    m_dirty = false;
+
+    const auto fileName = historyFileName();
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+    QSaveFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        qCWarning(lcSession, "Failed to save launch history to \"%s\": %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << HistoryMagic << HistoryVersion << quint32(m_entries.size());
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+        stream << it.key() << it->count << it->lastLaunch << it->files
+               << it->execLatency << it->windowLatency;
+
+    if (!file.commit())
+        qCWarning(lcSession, "Failed to save launch history to \"%s\": %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+}
+
+void LaunchHistory::scheduleSave()
+{
+    m_dirty = true;
+    if (!m_saveTimer->isActive())
+        m_saveTimer->start();
+}
+
+void LaunchHistory::recordLatency(QVector<quint32> &histogram, qint64 msecs)
+{
+    if (histogram.size() != latencyBuckets.size() + 1)
+        histogram.fill(0, latencyBuckets.size() + 1);
+
+    int bucket = 0;
+    while (bucket < latencyBuckets.size() && msecs > latencyBuckets.at(bucket))
+        ++bucket;
+    histogram[bucket]++;
+
+    scheduleSave();
+}
@@ -0,0 +1,62 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef LAUNCHHISTORY_H
+#define LAUNCHHISTORY_H
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+
+class QTimer;
+
+/*
+ * Programs launched by the user: how often, how fast they start
+ * and which files they map, to warm up the page cache at login.
+ */
+class LaunchHistory : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LaunchHistory(QObject *parent = nullptr);
+    ~LaunchHistory();
+
+    void recordLaunch(const QString &appId);
+    void recordFiles(const QString &appId, qint64 pid);
+    void recordExecLatency(const QString &appId, qint64 msecs);
+    void recordWindowLatency(const QString &appId, qint64 msecs);
+
+    QStringList topApplications(int count) const;
+    QVariantMap statistics() const;
+
+    void prefetch(int count);
+
+    static QString historyFileName();
+
+private:
+    struct Entry {
+        quint32 count = 0;
+        // Milliseconds since the epoch
+        qint64 lastLaunch = 0;
+        // Executable and shared libraries
+        QStringList files;
+        // Launches by latency bucket, from spawn to exec
+        // and from spawn to the first window
+        QVector<quint32> execLatency;
+        QVector<quint32> windowLatency;
+    };
+
+    QHash<QString, Entry> m_entries;
+    QTimer *m_saveTimer = nullptr;
+    bool m_dirty = false;
+
+    void load();
+    void save();
+    void scheduleSave();
+    void recordLatency(QVector<quint32> &histogram, qint64 msecs);
+};
+
+#endif // LAUNCHHISTORY_H
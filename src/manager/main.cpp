@@ -101,6 +101,18 @@ int main(int argc, char *argv[])
                 TR("list"));
     parser.addOption(disableModulesOption);
 
+    // Stop deadlines
+    QCommandLineOption moduleStopTimeoutOption(
+                QStringLiteral("module-stop-timeout"),
+                TR("How long to wait for each asynchronous module to stop, in milliseconds"),
+                TR("msecs"));
+    parser.addOption(moduleStopTimeoutOption);
+    QCommandLineOption logoutTimeoutOption(
+                QStringLiteral("logout-timeout"),
+                TR("How long to wait for the session to stop, in milliseconds (0 to wait indefinitely)"),
+                TR("msecs"));
+    parser.addOption(logoutTimeoutOption);
+
     // List modules
     QCommandLineOption listModulesOption(
             QStringLiteral("list-modules"),
@@ -139,6 +151,27 @@ int main(int argc, char *argv[])
     // Set systemd flag
     session->setSystemdEnabled(systemdSupport);
 
+    // Set stop deadlines
+    if (parser.isSet(moduleStopTimeoutOption)) {
+        bool ok = false;
+        const int msecs = parser.value(moduleStopTimeoutOption).toInt(&ok);
+        if (!ok || msecs <= 0) {
+            qWarning("Invalid module stop timeout");
+            return 1;
+        }
+        session->setModuleStopTimeout(msecs);
+    }
+    if (parser.isSet(logoutTimeoutOption)) {
+        // Waiting indefinitely must be asked for explicitly
+        bool ok = false;
+        const int msecs = parser.value(logoutTimeoutOption).toInt(&ok);
+        if (!ok || msecs < 0) {
+            qWarning("Invalid logout timeout");
+            return 1;
+        }
+        session->setLogoutTimeout(msecs);
+    }
+
     // Disable incompatible modules
     QSet<QString> disabledModules(disabledModulesList.begin(), disabledModulesList.end());
     if (systemdSupport) {
@@ -181,11 +214,9 @@ int main(int argc, char *argv[])
             return;
         }
 
-        // Start all services
-        if (!session->start()) {
-            QCoreApplication::exit(1);
-            return;
-        }
+        // Start all services, on failure the session is being closed
+        // and will quit with an error when all modules are stopped
+        session->start();
     });
 
     return app.exec();
@@ -0,0 +1,164 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QSettings>
+#include <QStandardPaths>
+
+#include "resourcepolicy.h"
+#include "session.h"
+
+#include <algorithm>
+#include <limits>
+
+static const QString policyFileName = QStringLiteral("liri-session/resources.conf");
+static const QString applicationsGroup = QStringLiteral("Applications");
+static const QString categoriesGroup = QStringLiteral("Categories");
+static const QString defaultProfile = QStringLiteral("default");
+
+// Percentages are scaled to this, like systemd does
+static const quint64 scaleMax = std::numeric_limits<quint32>::max();
+
+static bool parseWeight(const QString &value, SystemdProperty *property)
+{
+    bool ok = false;
+    const quint64 weight = value.toULongLong(&ok);
+    if (!ok || weight < 1 || weight > 10000)
+        return false;
+
+    property->value = QDBusVariant(QVariant::fromValue(weight));
+    return true;
+}
+
+static bool parseLimit(const QString &value, bool bytes, SystemdProperty *property)
+{
+    if (value == QLatin1String("infinity")) {
+        property->value = QDBusVariant(QVariant::fromValue(std::numeric_limits<quint64>::max()));
+        return true;
+    }
+
+    // Relative to the physical memory or to the maximum number of tasks
+    if (value.endsWith(QLatin1Char('%'))) {
+        bool ok = false;
+        const double percent = value.chopped(1).toDouble(&ok);
+        if (!ok || percent < 0 || percent > 100)
+            return false;
+
+        property->name.append(QLatin1String("Scale"));
+        property->value = QDBusVariant(QVariant::fromValue(
+                                           static_cast<quint32>(percent * scaleMax / 100)));
+        return true;
+    }
+
+    QString number = value;
+    quint64 multiplier = 1;
+    if (bytes && !number.isEmpty()) {
+        static const QString suffixes = QStringLiteral("KMGT");
+        const int index = suffixes.indexOf(number.at(number.size() - 1).toUpper());
+        if (index >= 0) {
+            number.chop(1);
+            multiplier = quint64(1) << (10 * (index + 1));
+        }
+    }
+
+    bool ok = false;
+    const quint64 limit = number.toULongLong(&ok);
+    if (!ok || limit > std::numeric_limits<quint64>::max() / multiplier)
+        return false;
+
+    property->value = QDBusVariant(QVariant::fromValue(limit * multiplier));
+    return true;
+}
+
+static bool parseProperty(const QString &key, const QString &value, SystemdProperty *property)
+{
+    property->name = key;
+
+    if (key == QLatin1String("CPUWeight") || key == QLatin1String("IOWeight"))
+        return parseWeight(value, property);
+    if (key == QLatin1String("MemoryHigh") || key == QLatin1String("MemoryLow"))
+        return parseLimit(value, true, property);
+    if (key == QLatin1String("TasksMax"))
+        return parseLimit(value, false, property);
+
+    return false;
+}
+
+void ResourcePolicy::load()
+{
+    m_profiles.clear();
+    m_applications.clear();
+    m_categories.clear();
+
+    // Files with higher precedence come first, and override the others
+    auto fileNames = QStandardPaths::locateAll(QStandardPaths::GenericConfigLocation, policyFileName);
+    std::reverse(fileNames.begin(), fileNames.end());
+
+    for (const auto &fileName : qAsConst(fileNames)) {
+        QSettings settings(fileName, QSettings::IniFormat);
+
+        const auto groups = settings.childGroups();
+        for (const auto &group : groups) {
+            settings.beginGroup(group);
+            const auto keys = settings.childKeys();
+
+            if (group == applicationsGroup || group == categoriesGroup) {
+                auto &map = group == applicationsGroup ? m_applications : m_categories;
+                for (const auto &key : keys)
+                    map.insert(key, settings.value(key).toString());
+            } else {
+                // Profiles are replaced as a whole
+                SystemdPropertyList properties;
+                for (const auto &key : keys) {
+                    const auto value = settings.value(key).toString().trimmed();
+                    SystemdProperty property;
+                    if (parseProperty(key, value, &property))
+                        properties.append(property);
+                    else
+                        qCWarning(lcSession, "Invalid resource control \"%s=%s\" in profile \"%s\" of \"%s\"",
+                                  qPrintable(key), qPrintable(value),
+                                  qPrintable(group), qPrintable(fileName));
+                }
+                m_profiles.insert(group, properties);
+            }
+
+            settings.endGroup();
+        }
+    }
+
+    qCDebug(lcSession, "Loaded %d resource profile(s)", int(m_profiles.size()));
+}
+
+SystemdPropertyList ResourcePolicy::properties(const QString &appId, const QString &profile,
+                                               const QStringList &categories) const
+{
+    const auto name = profileName(appId, profile, categories);
+    if (name.isEmpty())
+        return SystemdPropertyList();
+
+    qCDebug(lcSession, "Applying resource profile \"%s\" to \"%s\"",
+            qPrintable(name), qPrintable(appId));
+    return m_profiles.value(name);
+}
+
+QString ResourcePolicy::profileName(const QString &appId, const QString &profile,
+                                    const QStringList &categories) const
+{
+    const auto application = m_applications.value(appId);
+    if (m_profiles.contains(application))
+        return application;
+
+    if (m_profiles.contains(profile))
+        return profile;
+
+    for (const auto &category : categories) {
+        const auto name = m_categories.value(category);
+        if (m_profiles.contains(name))
+            return name;
+    }
+
+    if (m_profiles.contains(defaultProfile))
+        return defaultProfile;
+
+    return QString();
+}
@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef RESOURCEPOLICY_H
+#define RESOURCEPOLICY_H
+
+#include <QHash>
+#include <QStringList>
+
+#include "systemdmanager.h"
+
+/*
+ * Resource controls of application scopes.
+ *
+ * Profiles are sets of scope properties, applications are assigned a
+ * profile by ID, by the X-Liri-ResourceProfile key of their desktop file
+ * or by their categories, in this order; the "default" profile, if any,
+ * is used for everything else.
+ */
+class ResourcePolicy
+{
+public:
+    void load();
+
+    SystemdPropertyList properties(const QString &appId, const QString &profile,
+                                   const QStringList &categories) const;
+
+private:
+    QHash<QString, SystemdPropertyList> m_profiles;
+    QHash<QString, QString> m_applications;
+    QHash<QString, QString> m_categories;
+
+    QString profileName(const QString &appId, const QString &profile,
+                        const QStringList &categories) const;
+};
+
+#endif // RESOURCEPOLICY_H
@@ -25,9 +25,12 @@
 #include <QDBusConnection>
 #include <QDBusMessage>
 #include <QDBusMetaType>
-#include <QDBusReply>
+#include <QDBusPendingCallWatcher>
 #include <QProcess>
+#include <QSharedPointer>
+#include <QTimer>
 
+#include <libpluginregistry/pluginregistry.h>
 #include <libsigwatch/sigwatch.h>
 
 #include <LiriSession/private/sessionmodule_p.h>
@@ -37,7 +40,7 @@
 #include "dbus/sessionmanager.h"
 #include "diagnostics.h"
 #include "gitsha1.h"
-#include "pluginregistry.h"
+#include "idletracker.h"
 #include "session.h"
 #include "systemdmanager.h"
 #include "utils.h"
@@ -48,20 +51,48 @@ Q_IMPORT_PLUGIN(AutostartPlugin)
 Q_IMPORT_PLUGIN(ServicesPlugin)
 Q_IMPORT_PLUGIN(ShellPlugin)
 
-// D-Bus type to update activation environment
-typedef QMap<QString,QString> EnvMap;
-Q_DECLARE_METATYPE(EnvMap)
+// Environment changes are collected for this amount of milliseconds
+// and then uploaded all at once
+static const int uploadEnvironmentDelay = 50;
+
+// Default deadline for each module to stop, in milliseconds
+static const int defaultModuleStopTimeout = 4000;
+
+// Default time budget for the whole logout, in milliseconds; it's
+// shorter than the default logind InhibitDelayMaxSec
+static const int defaultLogoutTimeout = 4500;
 
 Session::Session(QObject *parent)
     : QObject(parent)
+    , m_idleTracker(new IdleTracker(this))
     , m_processLauncher(new ProcessLauncher(this))
     , m_screenSaver(new ScreenSaver(this))
     , m_manager(new SessionManager(this))
-    , m_pluginRegistry(new PluginRegistry(this))
+    , m_pluginRegistry(new PluginRegistry(
+                           QStringLiteral("SessionModule"),
+                           QStringList({QStringLiteral(LiriSessionModule_iid),
+                                        QStringLiteral(LiriAsyncSessionModule_iid)}),
+                           QString::asprintf("%s/liri/sessionmodules", PLUGINSDIR),
+                           this))
+    , m_moduleStopTimeout(defaultModuleStopTimeout)
+    , m_logoutTimeout(defaultLogoutTimeout)
 {
     // Register D-Bus types
     qDBusRegisterMetaType<EnvMap>();
 
+    // Coalesce bursts of environment changes into a single upload
+    m_uploadEnvironmentTimer = new QTimer(this);
+    m_uploadEnvironmentTimer->setSingleShot(true);
+    m_uploadEnvironmentTimer->setInterval(uploadEnvironmentDelay);
+    connect(m_uploadEnvironmentTimer, &QTimer::timeout,
+            this, &Session::uploadEnvironment);
+
+    // Quit when the logout takes too long
+    m_logoutTimer = new QTimer(this);
+    m_logoutTimer->setSingleShot(true);
+    connect(m_logoutTimer, &QTimer::timeout,
+            this, &Session::handleLogoutTimeout);
+
     // Unix signals watcher
     UnixSignalWatcher *sigwatch = new UnixSignalWatcher(this);
     sigwatch->watchForSignal(SIGINT);
@@ -93,6 +124,26 @@ void Session::setSystemdEnabled(bool value)
     m_systemd = new SystemdManager(this);
 }
 
+SystemdManager *Session::systemdManager() const
+{
+    return m_systemd;
+}
+
+IdleTracker *Session::idleTracker() const
+{
+    return m_idleTracker;
+}
+
+void Session::setModuleStopTimeout(int msecs)
+{
+    m_moduleStopTimeout = msecs;
+}
+
+void Session::setLogoutTimeout(int msecs)
+{
+    m_logoutTimeout = msecs;
+}
+
 bool Session::requireDBusSession()
 {
     // Don't continue if we are already in a D-Bus session
@@ -122,19 +173,16 @@ bool Session::requireDBusSession()
 
 QStringList Session::moduleNames() const
 {
-    QStringList list;
-
-    const auto modules = m_modules.values();
-    for (const auto &modulesList : modules) {
-        for (const auto &module : modulesList) {
-            const auto name = m_pluginRegistry->getNameForInstance(module);
-            list.append(name);
-        }
-    }
-
+    auto list = m_pluginRegistry->pluginNames();
+    list.sort();
     return list;
 }
 
+Timeline *Session::timeline()
+{
+    return &m_timeline;
+}
+
 void Session::disableModule(const QString &name)
 {
     m_disabledModules.append(name);
@@ -147,31 +195,16 @@ void Session::setModuleArguments(const QString &name, const QStringList &args)
 
 void Session::loadPlugins()
 {
-    // Discover plugins
-    m_pluginRegistry->discover();
-
-    // Add modules to the list
-    PluginsMap plugins = m_pluginRegistry->plugins();
-    PluginsMap::iterator it;
-    for (it = plugins.begin(); it != plugins.end(); ++it) {
-        auto name = it.key();
-        auto instance = it.value();
-        auto module = dynamic_cast<Liri::SessionModule *>(instance);
+    TimelineScope scope(&m_timeline, QStringLiteral("loadPlugins"), QStringLiteral("initialize"));
 
-        if (!module) {
-            qCWarning(lcSession, "Plugin \"%s\" is not a session module",
-                      qPrintable(name));
-            continue;
-        }
-
-        Liri::SessionModulePrivate::get(module)->setSystemdEnabled(m_systemdEnabled);
-
-        m_modules[module->startupPhase()].append(module);
-    }
+    // Discover plugins, they are instantiated only when started
+    m_pluginRegistry->discover();
 }
 
 bool Session::initialize()
 {
+    TimelineScope scope(&m_timeline, QStringLiteral("initialize"), QStringLiteral("initialize"));
+
     // Print version information
     qInfo("== Liri Session ==\n"
           "** https://liri.io\n"
@@ -183,11 +216,20 @@ bool Session::initialize()
     qInfo("%s", qPrintable(Diagnostics::systemInformation().trimmed()));
 
     // Register D-Bus objects
-    m_screenSaver->registerWithDBus();
-    if (!m_processLauncher->registerWithDBus())
-        return false;
-    if (!m_manager->registerWithDBus())
-        return false;
+    {
+        TimelineScope scope(&m_timeline, QStringLiteral("registerWithDBus: ScreenSaver"), QStringLiteral("dbus"));
+        m_screenSaver->registerWithDBus();
+    }
+    {
+        TimelineScope scope(&m_timeline, QStringLiteral("registerWithDBus: ProcessLauncher"), QStringLiteral("dbus"));
+        if (!m_processLauncher->registerWithDBus())
+            return false;
+    }
+    {
+        TimelineScope scope(&m_timeline, QStringLiteral("registerWithDBus: SessionManager"), QStringLiteral("dbus"));
+        if (!m_manager->registerWithDBus())
+            return false;
+    }
 
     // Load plugins
     loadPlugins();
@@ -203,51 +245,28 @@ bool Session::start()
     // Start systemd target
     if (m_systemdEnabled) {
         const QString targetName = QStringLiteral("liri-session.target");
-        if (m_systemd->loadUnit(targetName))
-            m_systemd->startUnit(targetName, QStringLiteral("replace"));
+        const int eventId = m_timeline.begin(QStringLiteral("startUnit: %1").arg(targetName),
+                                             QStringLiteral("systemd"));
+        connect(m_systemd, &SystemdManager::jobFinished, this,
+                [this, targetName, eventId](const QString &unit, const QString &result) {
+            if (unit != targetName)
+                return;
+
+            m_timeline.end(eventId);
+            if (result != QLatin1String("done"))
+                qCWarning(lcSession, "Start job for \"%s\" finished with result \"%s\"",
+                          qPrintable(unit), qPrintable(result));
+        });
+
+        // Requests are queued after the environment upload, there's no
+        // need to wait for the replies before sending the next one
+        m_systemd->loadUnit(targetName);
+        m_systemd->startUnit(targetName, QStringLiteral("replace"));
     }
 
-    // Run all modules of each startup phase
-    ModulesMap::iterator it;
-    for (it = m_modules.begin(); it != m_modules.end(); ++it) {
-        ModulesList list = it.value();
-        for (int i = 0; i < list.count(); i++) {
-            auto module = list.at(i);
-            auto name = m_pluginRegistry->getNameForInstance(module);
-            if (!module) {
-                qCWarning(lcSession, "Ignoring invalid session module \"%s\"",
-                          qPrintable(name));
-                continue;
-            }
-
-            // Skip disabled modules
-            if (m_disabledModules.contains(name))
-                continue;
-
-            // Let the module set environment variables directly
-            connect(module, &Liri::SessionModule::environmentChangeRequested,
-                    this, &Session::setEnvironment);
-            connect(module, &Liri::SessionModule::shutdownRequested,
-                    this, &Session::shutdown);
-
-            qCInfo(lcSession, "==> Starting session module \"%s\"",
-                   qPrintable(name));
-
-            // Start
-            if (module->start(m_moduleArgs[name])) {
-                m_loadedModules.append(module);
-                qCInfo(lcSession, "Session module \"%s\" started",
-                       qPrintable(name));
-            } else {
-                qCWarning(lcSession, "Failed to start session module \"%s\"",
-                          qPrintable(name));
-                shutdown();
-                return false;
-            }
-        }
-    }
-
-    return true;
+    // Start modules as soon as their dependencies are satisfied
+    buildModuleGraph();
+    return scheduleModules();
 }
 
 void Session::setEnvironment(const QString &key, const QString &value)
@@ -256,9 +275,23 @@ void Session::setEnvironment(const QString &key, const QString &value)
     qCDebug(lcSession, "Setting environment variable %s=\"%s\"",
             qPrintable(key), qPrintable(value));
     qputenv(qPrintable(key), value.toLocal8Bit());
+    m_unsetEnvironmentKeys.removeAll(key);
 
     // Propagate environment variables to D-Bus activate services
-    uploadEnvironment();
+    scheduleEnvironmentUpload();
+}
+
+void Session::setEnvironmentBatch(const EnvMap &environment)
+{
+    for (auto it = environment.constBegin(); it != environment.constEnd(); ++it) {
+        qCDebug(lcSession, "Setting environment variable %s=\"%s\"",
+                qPrintable(it.key()), qPrintable(it.value()));
+        qputenv(qPrintable(it.key()), it.value().toLocal8Bit());
+        m_unsetEnvironmentKeys.removeAll(it.key());
+    }
+
+    // Propagate environment variables to D-Bus activate services
+    scheduleEnvironmentUpload();
 }
 
 void Session::unsetEnvironment(const QString &key)
@@ -267,37 +300,472 @@ void Session::unsetEnvironment(const QString &key)
     qCDebug(lcSession, "Unsetting environment variable %s",
             qPrintable(key));
     qunsetenv(qPrintable(key));
+    if (!m_unsetEnvironmentKeys.contains(key))
+        m_unsetEnvironmentKeys.append(key);
 
-    // Synchronously update systemd environment
-    if (m_systemdEnabled)
-        m_systemd->unsetEnvironment(key);
+    // Propagate to systemd
+    scheduleEnvironmentUpload();
+}
+
+void Session::replyAfterEnvironmentUpload(const QDBusMessage &message)
+{
+    // Callers may activate services right after changing the
+    // environment, so they wait until it's propagated
+    m_environmentReplies.append(message.createReply());
+    if (!m_uploadEnvironmentTimer->isActive())
+        uploadEnvironment();
 }
 
 void Session::shutdown()
 {
+    if (m_shuttingDown)
+        return;
+    m_shuttingDown = true;
+
     qCInfo(lcSession, "Closing session...");
 
-    // Stop modules
-    std::reverse(m_loadedModules.begin(), m_loadedModules.end());
-    for (auto module : qAsConst(m_loadedModules)) {
-        auto instance = dynamic_cast<QObject *>(module);
-        const auto name = m_pluginRegistry->getNameForInstance(instance);
+    m_shutdownTimer.start();
+    m_shutdownEventId = m_timeline.begin(QStringLiteral("shutdown"), QStringLiteral("shutdown"));
 
-        qCInfo(lcSession, "==> Stopping session module \"%s\"",
-               qPrintable(name));
+    // Don't let modules hold up the logout indefinitely
+    if (m_logoutTimeout > 0)
+        m_logoutTimer->start(m_logoutTimeout);
 
-        if (!module->stop())
-            qCWarning(lcSession, "Failed to stop session module \"%s\"",
-                      qPrintable(name));
+    // Modules are stopped one phase at a time in reverse order, and
+    // the modules of the same phase are stopped in parallel; modules
+    // that are still in the process of being started are stopped too
+    ModulesMap modules;
+    for (const auto &node : qAsConst(m_moduleNodes)) {
+        if (node.state == ModuleNode::Starting)
+            modules[node.module->startupPhase()].append(node.module);
+    }
+    for (auto *module : qAsConst(m_loadedModules))
+        modules[module->startupPhase()].append(module);
+
+    m_phasesToStop.clear();
+    for (auto it = modules.constBegin(); it != modules.constEnd(); ++it)
+        m_phasesToStop.prepend(it.value());
+
+    stopNextPhase();
+}
+
+void Session::stopNextPhase()
+{
+    // Wait for the current phase to complete
+    if (!m_pendingStops.isEmpty())
+        return;
+
+    while (!m_phasesToStop.isEmpty()) {
+        const auto modules = m_phasesToStop.takeFirst();
+        for (auto *module : modules)
+            stopModule(module);
+
+        if (!m_pendingStops.isEmpty())
+            return;
+    }
+
+    finishShutdown();
+}
+
+void Session::stopModule(Liri::SessionModule *module)
+{
+    auto instance = dynamic_cast<QObject *>(module);
+    const auto name = m_pluginRegistry->getNameForInstance(instance);
+
+    qCInfo(lcSession, "==> Stopping session module \"%s\"",
+           qPrintable(name));
+
+    PendingStop pending;
+    pending.name = name;
+    pending.eventId = m_timeline.begin(QStringLiteral("stop: %1").arg(name), QStringLiteral("module"));
+    pending.elapsedTimer.start();
+
+    // Asynchronous modules are stopped in parallel, each one
+    // with its own deadline
+    auto *asyncModule = qobject_cast<Liri::AsyncSessionModule *>(module);
+    if (asyncModule) {
+        const auto metaData = m_pluginRegistry->getMetaData(name);
+        const int timeout = metaData.value(QStringLiteral("X-Liri-SessionModule-StopTimeout"),
+                                           m_moduleStopTimeout).toInt();
+
+        pending.deadlineTimer = new QTimer(this);
+        pending.deadlineTimer->setSingleShot(true);
+        connect(pending.deadlineTimer, &QTimer::timeout, this, [this, module, timeout] {
+            const auto pending = m_pendingStops.value(module);
+            qCWarning(lcSession, "Session module \"%s\" didn't stop within %d ms, giving up",
+                      qPrintable(pending.name), timeout);
+            handleModuleStopped(module);
+        });
+        pending.stoppedConnection =
+                connect(asyncModule, &Liri::AsyncSessionModule::stopped, this, [this, module] {
+            handleModuleStopped(module);
+        }, Qt::SingleShotConnection);
+
+        // Modules might emit stopped() right away
+        m_pendingStops.insert(module, pending);
+        pending.deadlineTimer->start(timeout);
+        asyncModule->stopAsync();
+        return;
+    }
+
+    if (!module->stop())
+        qCWarning(lcSession, "Failed to stop session module \"%s\"",
+                  qPrintable(name));
+
+    m_timeline.end(pending.eventId);
+    qCInfo(lcSession, "Session module \"%s\" stopped in %lld ms",
+           qPrintable(name), pending.elapsedTimer.elapsed());
+}
+
+void Session::handleModuleStopped(Liri::SessionModule *module)
+{
+    auto it = m_pendingStops.find(module);
+    if (it == m_pendingStops.end())
+        return;
+
+    const auto pending = it.value();
+    m_pendingStops.erase(it);
+
+    disconnect(pending.stoppedConnection);
+    pending.deadlineTimer->stop();
+    pending.deadlineTimer->deleteLater();
+    m_timeline.end(pending.eventId);
+
+    qCInfo(lcSession, "Session module \"%s\" stopped in %lld ms",
+           qPrintable(pending.name), pending.elapsedTimer.elapsed());
+
+    // Move on when the whole phase is stopped, but not from
+    // within the stopAsync() call
+    if (m_pendingStops.isEmpty())
+        QMetaObject::invokeMethod(this, &Session::stopNextPhase, Qt::QueuedConnection);
+}
+
+void Session::handleLogoutTimeout()
+{
+    qCWarning(lcSession, "Session didn't stop within %d ms, quitting anyway",
+              m_logoutTimeout);
+
+    for (auto it = m_pendingStops.constBegin(); it != m_pendingStops.constEnd(); ++it) {
+        qCWarning(lcSession, "Session module \"%s\" is still stopping",
+                  qPrintable(it.value().name));
+        disconnect(it.value().stoppedConnection);
+        it.value().deadlineTimer->stop();
+        it.value().deadlineTimer->deleteLater();
+        m_timeline.end(it.value().eventId);
     }
+    m_pendingStops.clear();
+    m_phasesToStop.clear();
+
+    finishShutdown();
+}
 
+void Session::finishShutdown()
+{
+    m_logoutTimer->stop();
+    m_timeline.end(m_shutdownEventId);
+
+    qCInfo(lcSession, "Session stopped in %lld ms", m_shutdownTimer.elapsed());
     qCInfo(lcSession, "Quit");
 
-    QCoreApplication::quit();
+    QCoreApplication::exit(m_exitCode);
+}
+
+void Session::buildModuleGraph()
+{
+    const QString afterKey = QStringLiteral("X-Liri-SessionModule-After");
+    const QString requiresKey = QStringLiteral("X-Liri-SessionModule-Requires");
+
+    m_moduleNodes.clear();
+
+    // Instantiate the modules that are going to be started
+    ModulesMap modules;
+    const auto names = m_pluginRegistry->pluginNames();
+    for (const auto &name : names) {
+        // Skip disabled modules
+        if (m_disabledModules.contains(name))
+            continue;
+
+        auto *instance = m_pluginRegistry->getInstance(name);
+        auto *module = dynamic_cast<Liri::SessionModule *>(instance);
+        if (!module) {
+            qCWarning(lcSession, "Plugin \"%s\" is not a session module",
+                      qPrintable(name));
+            continue;
+        }
+
+        Liri::SessionModulePrivate::get(module)->setSystemdEnabled(m_systemdEnabled);
+
+        modules[module->startupPhase()].append(module);
+    }
+
+    // Modules that don't declare their dependencies are started
+    // after all the modules of the previous startup phases
+    QStringList previousPhasesModules;
+
+    ModulesMap::iterator it;
+    for (it = modules.begin(); it != modules.end(); ++it) {
+        QStringList phaseModules;
+
+        const ModulesList list = it.value();
+        for (auto *module : list) {
+            const auto name = m_pluginRegistry->getNameForInstance(module);
+            const auto metaData = m_pluginRegistry->getMetaData(name);
+
+            ModuleNode node;
+            node.name = name;
+            node.module = module;
+            node.requirements = metaData.value(requiresKey).toStringList();
+            if (metaData.contains(afterKey) || metaData.contains(requiresKey))
+                node.after = metaData.value(afterKey).toStringList();
+            else
+                node.after = previousPhasesModules;
+            m_moduleNodes.append(node);
+
+            phaseModules.append(name);
+        }
+
+        previousPhasesModules.append(phaseModules);
+    }
+}
+
+ModuleNode *Session::findModuleNode(const QString &name)
+{
+    for (auto &node : m_moduleNodes) {
+        if (node.name == name)
+            return &node;
+    }
+
+    return nullptr;
+}
+
+bool Session::isModuleReady(const ModuleNode &node)
+{
+    const auto dependencies = node.after + node.requirements;
+    for (const auto &name : dependencies) {
+        // Ordering dependencies on modules that are not going
+        // to be started are ignored
+        const auto *dependency = findModuleNode(name);
+        if (!dependency)
+            continue;
+
+        if (dependency->state == ModuleNode::Pending ||
+                dependency->state == ModuleNode::Starting)
+            return false;
+    }
+
+    return true;
+}
+
+bool Session::scheduleModules()
+{
+    bool progress = true;
+
+    while (progress && !m_shuttingDown) {
+        progress = false;
+
+        for (auto &node : m_moduleNodes) {
+            if (node.state != ModuleNode::Pending || !isModuleReady(node))
+                continue;
+
+            progress = true;
+
+            // Don't start modules whose requirements are missing
+            QString missing;
+            for (const auto &name : qAsConst(node.requirements)) {
+                const auto *dependency = findModuleNode(name);
+                if (!dependency || dependency->state == ModuleNode::Skipped ||
+                        dependency->state == ModuleNode::Failed) {
+                    missing = name;
+                    break;
+                }
+            }
+            if (!missing.isEmpty()) {
+                qCWarning(lcSession, "Not starting session module \"%s\": "
+                                     "required module \"%s\" is not available",
+                          qPrintable(node.name), qPrintable(missing));
+                node.state = ModuleNode::Skipped;
+                continue;
+            }
+
+            if (!startModule(node))
+                return false;
+        }
+
+        // Nothing could be started but some modules are still waiting:
+        // unless we are waiting for modules that are still starting,
+        // there's a dependency cycle, break it following the startup
+        // phases order
+        if (!progress) {
+            bool starting = false;
+            for (const auto &node : qAsConst(m_moduleNodes)) {
+                if (node.state == ModuleNode::Starting) {
+                    starting = true;
+                    break;
+                }
+            }
+            if (starting)
+                break;
+
+            for (auto &node : m_moduleNodes) {
+                if (node.state == ModuleNode::Pending) {
+                    qCWarning(lcSession, "Dependency cycle detected, ignoring the "
+                                         "dependencies of session module \"%s\"",
+                              qPrintable(node.name));
+                    node.after.clear();
+                    node.requirements.clear();
+                    progress = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (m_shuttingDown)
+        return false;
+
+    finishStartup();
+
+    return true;
+}
+
+bool Session::startModule(ModuleNode &node)
+{
+    auto *module = node.module;
+    const auto name = node.name;
+
+    // Let the module set environment variables directly
+    connect(module, &Liri::SessionModule::environmentChangeRequested,
+            this, &Session::setEnvironment);
+    connect(module, &Liri::SessionModule::shutdownRequested,
+            this, &Session::shutdown);
+
+    qCInfo(lcSession, "==> Starting session module \"%s\"",
+           qPrintable(name));
+
+    node.state = ModuleNode::Starting;
+    node.eventId = m_timeline.begin(QStringLiteral("start: %1").arg(name), QStringLiteral("module"));
+
+    // Modules implementing the asynchronous interface tell us when they
+    // are ready, meanwhile other modules can be started
+    auto *asyncModule = qobject_cast<Liri::AsyncSessionModule *>(module);
+    if (asyncModule) {
+        connect(asyncModule, &Liri::AsyncSessionModule::ready, this, [this, name] {
+            handleModuleStarted(name);
+            scheduleModules();
+        });
+        connect(asyncModule, &Liri::AsyncSessionModule::failed, this, [this, name](const QString &errorMessage) {
+            handleModuleFailed(name, errorMessage);
+        });
+        asyncModule->startAsync(m_moduleArgs[name]);
+        return !m_shuttingDown;
+    }
+
+    // Start
+    if (module->start(m_moduleArgs[name])) {
+        handleModuleStarted(name);
+        return true;
+    }
+
+    handleModuleFailed(name, QString());
+    return false;
+}
+
+void Session::handleModuleStarted(const QString &name)
+{
+    auto *node = findModuleNode(name);
+    if (!node || node->state != ModuleNode::Starting)
+        return;
+
+    node->state = ModuleNode::Started;
+    m_timeline.end(node->eventId);
+    m_loadedModules.append(node->module);
+
+    qCInfo(lcSession, "Session module \"%s\" started",
+           qPrintable(name));
+
+    finishShellStartup();
+}
+
+void Session::handleModuleFailed(const QString &name, const QString &errorMessage)
+{
+    auto *node = findModuleNode(name);
+    if (!node || node->state != ModuleNode::Starting)
+        return;
+
+    node->state = ModuleNode::Failed;
+    m_timeline.end(node->eventId);
+
+    if (errorMessage.isEmpty())
+        qCWarning(lcSession, "Failed to start session module \"%s\"",
+                  qPrintable(name));
+    else
+        qCWarning(lcSession, "Failed to start session module \"%s\": %s",
+                  qPrintable(name), qPrintable(errorMessage));
+
+    // Quit with a failure code once the other modules are stopped
+    m_exitCode = 1;
+    shutdown();
+}
+
+void Session::finishShellStartup()
+{
+    if (m_shellStarted)
+        return;
+
+    // The shell is ready when the modules up to its phase are started
+    for (const auto &node : qAsConst(m_moduleNodes)) {
+        if (node.module->startupPhase() <= Liri::SessionModule::WindowManager &&
+                (node.state == ModuleNode::Pending || node.state == ModuleNode::Starting))
+            return;
+    }
+    m_shellStarted = true;
+
+    // Warm up the page cache for what the user is likely to launch
+    m_processLauncher->prefetchApplications();
+}
+
+void Session::finishStartup()
+{
+    // Wait for all modules to be started
+    for (const auto &node : qAsConst(m_moduleNodes)) {
+        if (node.state == ModuleNode::Pending || node.state == ModuleNode::Starting)
+            return;
+    }
+
+    if (m_startupFinished)
+        return;
+    m_startupFinished = true;
+
+    qCInfo(lcSession, "Session started");
+
+    // Dump the timeline in Chrome trace format, when requested
+    if (qEnvironmentVariableIsSet("LIRI_SESSION_STARTUP_TRACE")) {
+        const auto runtimeDir = qEnvironmentVariable("XDG_RUNTIME_DIR");
+        if (runtimeDir.isEmpty()) {
+            qCWarning(lcSession, "Cannot write startup trace: XDG_RUNTIME_DIR is not set");
+        } else {
+            const auto fileName = runtimeDir + QStringLiteral("/liri-session-startup-trace.json");
+            if (m_timeline.writeChromeTrace(fileName))
+                qCInfo(lcSession, "Startup trace written to \"%s\"", qPrintable(fileName));
+        }
+    }
+}
+
+void Session::scheduleEnvironmentUpload()
+{
+    // Don't postpone the upload any further if the timer is already
+    // running, so that a continuous stream of changes is still propagated
+    if (!m_uploadEnvironmentTimer->isActive())
+        m_uploadEnvironmentTimer->start();
 }
 
 void Session::uploadEnvironment()
 {
+    // Changes scheduled so far are part of this upload
+    m_uploadEnvironmentTimer->stop();
+
+    TimelineScope scope(&m_timeline, QStringLiteral("uploadEnvironment"), QStringLiteral("environment"));
+
     QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
     QProcessEnvironment sysEnv(env);
 
@@ -317,27 +785,96 @@ void Session::uploadEnvironment()
             sysEnv.remove(key);
     }
 
-    // Synchronously update activation environment
-    {
-        EnvMap envMap;
-        const auto keys = sysEnv.keys();
-        for (const auto &key : keys)
-            envMap.insert(key, sysEnv.value(key));
+    // Only propagate what changed since the last upload
+    EnvMap envMap;
+    EnvMap changes;
+    const auto names = sysEnv.keys();
+    for (const auto &key : names) {
+        const auto value = sysEnv.value(key);
+        envMap.insert(key, value);
+
+        auto it = m_env.constFind(key);
+        if (it == m_env.constEnd() || it.value() != value)
+            changes.insert(key, value);
+    }
+    QStringList removedKeys = m_unsetEnvironmentKeys;
+    for (auto it = m_env.constBegin(); it != m_env.constEnd(); ++it) {
+        if (!envMap.contains(it.key()) && !removedKeys.contains(it.key()))
+            removedKeys.append(it.key());
+    }
+    m_unsetEnvironmentKeys.clear();
+
+    // Reply to the callers once all the calls below are finished,
+    // this function holds one reference until it returns
+    auto pendingCalls = QSharedPointer<int>::create(1);
+    const auto replies = m_environmentReplies;
+    m_environmentReplies.clear();
+    auto sendReplies = [pendingCalls, replies] {
+        if (--(*pendingCalls) > 0)
+            return;
+        for (const auto &reply : replies)
+            QDBusConnection::sessionBus().send(reply);
+    };
+
+    if (changes.isEmpty() && removedKeys.isEmpty()) {
+        sendReplies();
+        return;
+    }
+
+    // Assume the upload succeeds, otherwise send everything again next time
+    m_env = envMap;
+    auto handleFailure = [this, removedKeys, sendReplies](QDBusPendingCallWatcher *self) {
+        sendReplies();
+
+        if (self->isError()) {
+            m_env.clear();
+            for (const auto &key : removedKeys) {
+                if (!m_unsetEnvironmentKeys.contains(key))
+                    m_unsetEnvironmentKeys.append(key);
+            }
+        }
 
+        self->deleteLater();
+    };
+
+    // Update activation environment, variables cannot be removed
+    // from there so only the changes are sent
+    if (!changes.isEmpty()) {
         auto msg = QDBusMessage::createMethodCall(
                     QStringLiteral("org.freedesktop.DBus"),
                     QStringLiteral("/org/freedesktop/DBus"),
                     QStringLiteral("org.freedesktop.DBus"),
                     QStringLiteral("UpdateActivationEnvironment"));
         msg.setAutoStartService(false);
-        msg.setArguments(QVariantList({QVariant::fromValue(envMap)}));
-        QDBusReply<void> reply = QDBusConnection::sessionBus().call(msg);
-        if (!reply.isValid())
-            qCWarning(lcSession, "Failed to update activation environment: %s",
-                      qPrintable(reply.error().message()));
+        msg.setArguments(QVariantList({QVariant::fromValue(changes)}));
+        QDBusPendingCall call = QDBusConnection::sessionBus().asyncCall(msg);
+        auto *watcher = new QDBusPendingCallWatcher(call, this);
+        ++(*pendingCalls);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [handleFailure](QDBusPendingCallWatcher *self) {
+            if (self->isError())
+                qCWarning(lcSession, "Failed to update activation environment: %s",
+                          qPrintable(self->error().message()));
+            handleFailure(self);
+        });
+    }
+
+    // Update systemd environment
+    if (m_systemdEnabled) {
+        if (!removedKeys.isEmpty()) {
+            auto *watcher = new QDBusPendingCallWatcher(m_systemd->unsetEnvironment(removedKeys), this);
+            ++(*pendingCalls);
+            connect(watcher, &QDBusPendingCallWatcher::finished, this, handleFailure);
+        }
+
+        if (!changes.isEmpty()) {
+            QStringList variables;
+            for (auto it = changes.constBegin(); it != changes.constEnd(); ++it)
+                variables.append(it.key() + QLatin1Char('=') + it.value());
+            auto *watcher = new QDBusPendingCallWatcher(m_systemd->setEnvironment(variables), this);
+            ++(*pendingCalls);
+            connect(watcher, &QDBusPendingCallWatcher::finished, this, handleFailure);
+        }
     }
 
-    // Synchronously update systemd environment
-    if (m_systemdEnabled)
-        m_systemd->setEnvironment(sysEnv);
+    sendReplies();
 }
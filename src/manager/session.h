@@ -24,24 +24,66 @@
 #ifndef SESSION_H
 #define SESSION_H
 
+#include <QDBusMessage>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QLoggingCategory>
+#include <QMap>
 #include <QObject>
 #include <QProcessEnvironment>
 #include <QVector>
 
 #include <LiriSession/SessionModule>
 
+#include "timeline.h"
+
 Q_DECLARE_LOGGING_CATEGORY(lcSession)
 
+class IdleTracker;
 class PluginRegistry;
 class ProcessLauncher;
 class ScreenSaver;
 class SessionManager;
 class SystemdManager;
+class QTimer;
+
+// D-Bus type to update activation environment
+typedef QMap<QString,QString> EnvMap;
+Q_DECLARE_METATYPE(EnvMap)
 
 typedef QVector<Liri::SessionModule *> ModulesList;
 typedef QMap<Liri::SessionModule::StartupPhase, ModulesList> ModulesMap;
 
+struct ModuleNode
+{
+    enum State {
+        Pending,
+        Starting,
+        Started,
+        Skipped,
+        Failed
+    };
+
+    QString name;
+    Liri::SessionModule *module = nullptr;
+    // Modules that must be started before this one
+    QStringList after;
+    // Modules that must be started before this one, and without
+    // which this module is not started at all
+    QStringList requirements;
+    State state = Pending;
+    int eventId = -1;
+};
+
+struct PendingStop
+{
+    QString name;
+    int eventId = -1;
+    QElapsedTimer elapsedTimer;
+    QTimer *deadlineTimer = nullptr;
+    QMetaObject::Connection stoppedConnection;
+};
+
 class Session : public QObject
 {
     Q_OBJECT
@@ -52,36 +94,79 @@ public:
     bool isSystemdEnabled() const;
     void setSystemdEnabled(bool value);
 
+    void setModuleStopTimeout(int msecs);
+    void setLogoutTimeout(int msecs);
+
+    SystemdManager *systemdManager() const;
+    IdleTracker *idleTracker() const;
+
     bool requireDBusSession();
 
     QStringList moduleNames() const;
 
+    Timeline *timeline();
+
     void disableModule(const QString &name);
     void setModuleArguments(const QString &name,
                             const QStringList &args);
 
+    void replyAfterEnvironmentUpload(const QDBusMessage &message);
+
     void loadPlugins();
     bool initialize();
     bool start();
 
 public Q_SLOTS:
     void setEnvironment(const QString &key, const QString &value);
+    void setEnvironmentBatch(const EnvMap &environment);
     void unsetEnvironment(const QString &key);
     void shutdown();
 
 private:
     QMap<QString, QString> m_env;
+    QStringList m_unsetEnvironmentKeys;
+    QTimer *m_uploadEnvironmentTimer = nullptr;
+    QVector<QDBusMessage> m_environmentReplies;
     bool m_systemdEnabled = false;
     SystemdManager *m_systemd = nullptr;
+    IdleTracker *m_idleTracker = nullptr;
     ProcessLauncher *m_processLauncher = nullptr;
     ScreenSaver *m_screenSaver = nullptr;
     SessionManager *m_manager = nullptr;
     QStringList m_disabledModules;
     QMap<QString, QStringList> m_moduleArgs;
     PluginRegistry *m_pluginRegistry = nullptr;
-    ModulesMap m_modules;
     ModulesList m_loadedModules;
-
+    bool m_shuttingDown = false;
+    int m_exitCode = 0;
+    int m_moduleStopTimeout;
+    int m_logoutTimeout;
+    QTimer *m_logoutTimer = nullptr;
+    QElapsedTimer m_shutdownTimer;
+    int m_shutdownEventId = -1;
+    QList<ModulesList> m_phasesToStop;
+    QHash<Liri::SessionModule *, PendingStop> m_pendingStops;
+    QVector<ModuleNode> m_moduleNodes;
+    bool m_shellStarted = false;
+    bool m_startupFinished = false;
+    Timeline m_timeline;
+
+    void buildModuleGraph();
+    ModuleNode *findModuleNode(const QString &name);
+    bool isModuleReady(const ModuleNode &node);
+    bool scheduleModules();
+    bool startModule(ModuleNode &node);
+    void handleModuleStarted(const QString &name);
+    void handleModuleFailed(const QString &name, const QString &errorMessage);
+    void stopNextPhase();
+    void stopModule(Liri::SessionModule *module);
+    void handleModuleStopped(Liri::SessionModule *module);
+    void handleLogoutTimeout();
+    void finishShutdown();
+    void finishShellStartup();
+    void finishStartup();
+
+    void scheduleEnvironmentUpload();
     void uploadEnvironment();
 };
 
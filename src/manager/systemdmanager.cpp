@@ -23,120 +23,223 @@
 
 #include <QDBusConnection>
 #include <QDBusConnectionInterface>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
 #include <QDBusReply>
 
 #include "session.h"
 #include "systemdmanager.h"
 
+const QString systemdService = QStringLiteral("org.freedesktop.systemd1");
+const QString systemdPath = QStringLiteral("/org/freedesktop/systemd1");
+const QString systemdManagerInterface = QStringLiteral("org.freedesktop.systemd1.Manager");
+
+QDBusArgument &operator<<(QDBusArgument &argument, const SystemdProperty &property)
+{
+    argument.beginStructure();
+    argument << property.name << property.value;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, SystemdProperty &property)
+{
+    argument.beginStructure();
+    argument >> property.name >> property.value;
+    argument.endStructure();
+    return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const SystemdAuxUnit &unit)
+{
+    argument.beginStructure();
+    argument << unit.name << unit.properties;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, SystemdAuxUnit &unit)
+{
+    argument.beginStructure();
+    argument >> unit.name >> unit.properties;
+    argument.endStructure();
+    return argument;
+}
+
 SystemdManager::SystemdManager(QObject *parent)
     : QObject(parent)
 {
-    // Search for systemd
-    QDBusReply<QStringList> reply = QDBusConnection::sessionBus().interface()->call(QStringLiteral("ListNames"));
-    m_available = reply.value().contains(QLatin1String("org.freedesktop.systemd1"));
+    qDBusRegisterMetaType<SystemdProperty>();
+    qDBusRegisterMetaType<SystemdPropertyList>();
+    qDBusRegisterMetaType<SystemdAuxUnit>();
+    qDBusRegisterMetaType<SystemdAuxUnitList>();
 }
 
 bool SystemdManager::isAvailable() const
 {
-    return m_available;
+    // Ask only once and only when needed
+    if (m_available < 0) {
+        auto *interface = QDBusConnection::sessionBus().interface();
+        if (interface) {
+            QDBusReply<bool> reply = interface->isServiceRegistered(systemdService);
+            m_available = reply.isValid() && reply.value() ? 1 : 0;
+        } else {
+            m_available = 0;
+        }
+    }
+
+    return m_available == 1;
 }
 
-bool SystemdManager::loadUnit(const QString &name)
+QDBusPendingReply<QDBusObjectPath> SystemdManager::loadUnit(const QString &name)
 {
-    auto msg = QDBusMessage::createMethodCall(
-                QStringLiteral("org.freedesktop.systemd1"),
-                QStringLiteral("/org/freedesktop/systemd1"),
-                QStringLiteral("org.freedesktop.systemd1.Manager"),
-                QStringLiteral("LoadUnit"));
-    msg.setAutoStartService(false);
-    msg.setArguments(QVariantList() << name);
-    QDBusReply<QDBusObjectPath> reply = QDBusConnection::sessionBus().call(msg);
-    if (!reply.isValid()) {
-        qCWarning(lcSession, "Unable to load unit \"%s\": %s",
-                  qPrintable(name), qPrintable(reply.error().message()));
-        return false;
-    }
+    return callManager(QStringLiteral("LoadUnit"), QVariantList() << name,
+                       QStringLiteral("Unable to load unit \"%1\"").arg(name));
+}
 
-    return true;
+QDBusPendingReply<QDBusObjectPath> SystemdManager::startUnit(const QString &name, const QString &mode)
+{
+    return queueJob(QStringLiteral("StartUnit"), name, QVariantList() << name << mode,
+                    QStringLiteral("Unable to start unit \"%1\"").arg(name));
 }
 
-bool SystemdManager::startUnit(const QString &name, const QString &mode)
+QDBusPendingReply<QDBusObjectPath> SystemdManager::stopUnit(const QString &name, const QString &mode)
 {
-    auto msg = QDBusMessage::createMethodCall(
-                QStringLiteral("org.freedesktop.systemd1"),
-                QStringLiteral("/org/freedesktop/systemd1"),
-                QStringLiteral("org.freedesktop.systemd1.Manager"),
-                QStringLiteral("StartUnit"));
-    msg.setAutoStartService(false);
-    msg.setArguments(QVariantList() << name << mode);
-    QDBusReply<QDBusObjectPath> reply = QDBusConnection::sessionBus().call(msg);
-    if (!reply.isValid()) {
-        qCWarning(lcSession, "Unable to start unit \"%s\": %s",
-                  qPrintable(name), qPrintable(reply.error().message()));
-        return false;
-    }
+    return queueJob(QStringLiteral("StopUnit"), name, QVariantList() << name << mode,
+                    QStringLiteral("Unable to stop unit \"%1\"").arg(name));
+}
 
-    return true;
+QDBusPendingReply<QDBusObjectPath> SystemdManager::startTransientUnit(const QString &name, const QString &mode,
+                                                                      const SystemdPropertyList &properties)
+{
+    const QVariantList args = QVariantList()
+            << name << mode
+            << QVariant::fromValue(properties)
+            << QVariant::fromValue(SystemdAuxUnitList());
+    return queueJob(QStringLiteral("StartTransientUnit"), name, args,
+                    QStringLiteral("Unable to start transient unit \"%1\"").arg(name));
 }
 
-bool SystemdManager::stopUnit(const QString &name, const QString &mode)
+QDBusPendingReply<> SystemdManager::killUnit(const QString &name, const QString &who, int signum)
 {
-    auto msg = QDBusMessage::createMethodCall(
-                QStringLiteral("org.freedesktop.systemd1"),
-                QStringLiteral("/org/freedesktop/systemd1"),
-                QStringLiteral("org.freedesktop.systemd1.Manager"),
-                QStringLiteral("StopUnit"));
-    msg.setAutoStartService(false);
-    msg.setArguments(QVariantList() << name << mode);
-    QDBusReply<QDBusObjectPath> reply = QDBusConnection::sessionBus().call(msg);
-    if (!reply.isValid()) {
-        qCWarning(lcSession, "Unable to stop unit \"%s\": %s",
-                  qPrintable(name), qPrintable(reply.error().message()));
-        return false;
-    }
+    return callManager(QStringLiteral("KillUnit"), QVariantList() << name << who << signum,
+                       QStringLiteral("Unable to kill unit \"%1\"").arg(name));
+}
+
+QDBusPendingReply<> SystemdManager::setEnvironment(const QStringList &variables)
+{
+    return callManager(QStringLiteral("SetEnvironment"), QVariantList() << variables,
+                       QStringLiteral("Failed to update systemd environment"));
+}
+
+QDBusPendingReply<> SystemdManager::unsetEnvironment(const QString &key)
+{
+    return unsetEnvironment(QStringList() << key);
+}
 
-    return true;
+QDBusPendingReply<> SystemdManager::unsetEnvironment(const QStringList &keys)
+{
+    return callManager(QStringLiteral("UnsetEnvironment"), QVariantList() << keys,
+                       QStringLiteral("Failed to unset environment variables from systemd"));
 }
 
-bool SystemdManager::setEnvironment(const QProcessEnvironment &sysEnv)
+QDBusPendingCall SystemdManager::callManager(const QString &method, const QVariantList &args,
+                                             const QString &errorMessage)
 {
     auto msg = QDBusMessage::createMethodCall(
-                QStringLiteral("org.freedesktop.systemd1"),
-                QStringLiteral("/org/freedesktop/systemd1"),
-                QStringLiteral("org.freedesktop.systemd1.Manager"),
-                QStringLiteral("SetEnvironment"));
+                systemdService, systemdPath, systemdManagerInterface, method);
     msg.setAutoStartService(false);
-    msg.setArguments(QVariantList() << sysEnv.toStringList());
-    QDBusReply<void> reply = QDBusConnection::sessionBus().call(msg);
-    if (!reply.isValid()) {
-        qCWarning(lcSession, "Failed to update systemd environment: %s",
-                  qPrintable(reply.error().message()));
-        return false;
-    }
+    msg.setArguments(args);
+
+    // Calls are queued in order on the same connection, hence callers
+    // can pipeline them without waiting for each reply
+    QDBusPendingCall call = QDBusConnection::sessionBus().asyncCall(msg);
+    auto *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [errorMessage](QDBusPendingCallWatcher *self) {
+        if (self->isError())
+            qCWarning(lcSession, "%s: %s", qPrintable(errorMessage),
+                      qPrintable(self->error().message()));
 
-    return true;
+        self->deleteLater();
+    });
+
+    return call;
 }
 
-bool SystemdManager::unsetEnvironment(const QString &key)
+QDBusPendingReply<QDBusObjectPath> SystemdManager::queueJob(const QString &method, const QString &name,
+                                                            const QVariantList &args, const QString &errorMessage)
 {
-    return unsetEnvironment(QStringList() << key);
+    // Make sure we receive JobRemoved before queueing the job
+    subscribe();
+
+    QDBusPendingReply<QDBusObjectPath> reply =
+            callManager(method, args, errorMessage);
+
+    auto *watcher = new QDBusPendingCallWatcher(reply, this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, name](QDBusPendingCallWatcher *self) {
+        QDBusPendingReply<QDBusObjectPath> reply = *self;
+        if (reply.isError()) {
+            Q_EMIT jobFinished(name, QStringLiteral("failed"));
+        } else {
+            const auto jobPath = reply.value().path();
+
+            // The job might have been completed even before we got here
+            if (m_removedJobs.contains(jobPath))
+                Q_EMIT jobFinished(name, m_removedJobs.take(jobPath));
+            else
+                m_jobs.insert(jobPath, name);
+        }
+
+        self->deleteLater();
+    });
+
+    return reply;
 }
 
-bool SystemdManager::unsetEnvironment(const QStringList &keys)
+void SystemdManager::subscribe()
 {
-    auto msg = QDBusMessage::createMethodCall(
-                QStringLiteral("org.freedesktop.systemd1"),
-                QStringLiteral("/org/freedesktop/systemd1"),
-                QStringLiteral("org.freedesktop.systemd1.Manager"),
-                QStringLiteral("UnsetEnvironment"));
-    msg.setAutoStartService(false);
-    msg.setArguments(QVariantList() << keys);
-    QDBusReply<void> reply = QDBusConnection::sessionBus().call(msg);
-    if (!reply.isValid()) {
-        qCWarning(lcSession, "Failed to unset environment variables from systemd: %s",
-                  qPrintable(reply.error().message()));
-        return false;
+    if (m_subscribed)
+        return;
+
+    auto bus = QDBusConnection::sessionBus();
+    m_subscribed = bus.connect(
+                systemdService, systemdPath, systemdManagerInterface,
+                QStringLiteral("JobRemoved"),
+                this, SLOT(handleJobRemoved(uint,QDBusObjectPath,QString,QString)));
+    if (!m_subscribed) {
+        qCWarning(lcSession, "Failed to connect to systemd JobRemoved signal");
+        return;
     }
 
-    return true;
+    // Transient units, such as application scopes, are removed
+    // when they are stopped and nothing is left in them
+    if (!bus.connect(systemdService, systemdPath, systemdManagerInterface,
+                     QStringLiteral("UnitRemoved"),
+                     this, SIGNAL(unitRemoved(QString))))
+        qCWarning(lcSession, "Failed to connect to systemd UnitRemoved signal");
+
+    // Signals are only emitted for clients that subscribed
+    callManager(QStringLiteral("Subscribe"), QVariantList(),
+                QStringLiteral("Failed to subscribe to systemd signals"));
+}
+
+void SystemdManager::handleJobRemoved(uint id, const QDBusObjectPath &job,
+                                      const QString &unit, const QString &result)
+{
+    Q_UNUSED(id)
+
+    const auto jobPath = job.path();
+
+    if (m_jobs.contains(jobPath)) {
+        m_jobs.remove(jobPath);
+        Q_EMIT jobFinished(unit, result);
+    } else {
+        // We don't know about this job yet, it might be one that
+        // we queued and whose reply is still on the way; other clients'
+        // jobs are also received here, so only keep the last few of them
+        while (m_removedJobsOrder.size() >= 64)
+            m_removedJobs.remove(m_removedJobsOrder.dequeue());
+        m_removedJobs.insert(jobPath, result);
+        m_removedJobsOrder.enqueue(jobPath);
+    }
 }
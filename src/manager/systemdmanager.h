@@ -24,9 +24,41 @@
 #ifndef SYSTEMDMANAGER_H
 #define SYSTEMDMANAGER_H
 
+#include <QDBusArgument>
+#include <QDBusObjectPath>
+#include <QDBusPendingReply>
+#include <QDBusVariant>
+#include <QHash>
 #include <QObject>
+#include <QQueue>
 
-class QProcessEnvironment;
+// D-Bus types for transient units
+class SystemdProperty
+{
+public:
+    QString name;
+    QDBusVariant value;
+};
+Q_DECLARE_METATYPE(SystemdProperty)
+
+typedef QList<SystemdProperty> SystemdPropertyList;
+Q_DECLARE_METATYPE(SystemdPropertyList)
+
+class SystemdAuxUnit
+{
+public:
+    QString name;
+    SystemdPropertyList properties;
+};
+Q_DECLARE_METATYPE(SystemdAuxUnit)
+
+typedef QList<SystemdAuxUnit> SystemdAuxUnitList;
+Q_DECLARE_METATYPE(SystemdAuxUnitList)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const SystemdProperty &property);
+const QDBusArgument &operator>>(const QDBusArgument &argument, SystemdProperty &property);
+QDBusArgument &operator<<(QDBusArgument &argument, const SystemdAuxUnit &unit);
+const QDBusArgument &operator>>(const QDBusArgument &argument, SystemdAuxUnit &unit);
 
 class SystemdManager : public QObject
 {
@@ -37,16 +69,38 @@ public:
 
     bool isAvailable() const;
 
-    bool loadUnit(const QString &name);
-    bool startUnit(const QString &name, const QString &mode);
-    bool stopUnit(const QString &name, const QString &mode);
+    QDBusPendingReply<QDBusObjectPath> loadUnit(const QString &name);
+    QDBusPendingReply<QDBusObjectPath> startUnit(const QString &name, const QString &mode);
+    QDBusPendingReply<QDBusObjectPath> stopUnit(const QString &name, const QString &mode);
+    QDBusPendingReply<QDBusObjectPath> startTransientUnit(const QString &name, const QString &mode,
+                                                          const SystemdPropertyList &properties);
+    QDBusPendingReply<> killUnit(const QString &name, const QString &who, int signum);
 
-    bool setEnvironment(const QProcessEnvironment &sysEnv);
-    bool unsetEnvironment(const QString &key);
-    bool unsetEnvironment(const QStringList &keys);
+    QDBusPendingReply<> setEnvironment(const QStringList &variables);
+    QDBusPendingReply<> unsetEnvironment(const QString &key);
+    QDBusPendingReply<> unsetEnvironment(const QStringList &keys);
+
+Q_SIGNALS:
+    void jobFinished(const QString &unit, const QString &result);
+    void unitRemoved(const QString &unit);
 
 private:
-    bool m_available = false;
+    mutable int m_available = -1;
+    bool m_subscribed = false;
+    QHash<QString, QString> m_jobs;
+    QHash<QString, QString> m_removedJobs;
+    // Removed jobs from the oldest
+    QQueue<QString> m_removedJobsOrder;
+
+    QDBusPendingCall callManager(const QString &method, const QVariantList &args,
+                                 const QString &errorMessage);
+    QDBusPendingReply<QDBusObjectPath> queueJob(const QString &method, const QString &name,
+                                                const QVariantList &args, const QString &errorMessage);
+    void subscribe();
+
+private Q_SLOTS:
+    void handleJobRemoved(uint id, const QDBusObjectPath &job,
+                          const QString &unit, const QString &result);
 };
 
 #endif // SYSTEMDMANAGER_H
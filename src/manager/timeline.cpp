@@ -0,0 +1,128 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "session.h"
+#include "timeline.h"
+
+#include <time.h>
+
+// Don't let the timeline grow indefinitely, since some steps such
+// as the environment upload keep happening after startup
+static const int maxEvents = 4096;
+
+QDBusArgument &operator<<(QDBusArgument &argument, const TimelineEvent &event)
+{
+    argument.beginStructure();
+    argument << event.name << event.category << event.start << event.duration;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, TimelineEvent &event)
+{
+    argument.beginStructure();
+    argument >> event.name >> event.category >> event.start >> event.duration;
+    argument.endStructure();
+    return argument;
+}
+
+// Timeline
+
+Timeline::Timeline()
+{
+    qDBusRegisterMetaType<TimelineEvent>();
+    qDBusRegisterMetaType<TimelineEventList>();
+}
+
+int Timeline::begin(const QString &name, const QString &category)
+{
+    if (m_events.size() >= maxEvents)
+        return -1;
+
+    TimelineEvent event;
+    event.name = name;
+    event.category = category;
+    event.start = now();
+    m_events.append(event);
+    return m_events.size() - 1;
+}
+
+void Timeline::end(int id)
+{
+    if (id < 0 || id >= m_events.size())
+        return;
+
+    auto &event = m_events[id];
+    if (event.duration < 0)
+        event.duration = now() - event.start;
+}
+
+TimelineEventList Timeline::events() const
+{
+    return m_events;
+}
+
+bool Timeline::writeChromeTrace(const QString &fileName) const
+{
+    const auto pid = QCoreApplication::applicationPid();
+
+    QJsonArray traceEvents;
+    for (const auto &event : qAsConst(m_events)) {
+        QJsonObject object;
+        object[QStringLiteral("name")] = event.name;
+        object[QStringLiteral("cat")] = event.category;
+        object[QStringLiteral("pid")] = pid;
+        object[QStringLiteral("tid")] = 1;
+        object[QStringLiteral("ts")] = event.start;
+        if (event.duration < 0) {
+            // Steps that never finished are shown as instant events
+            object[QStringLiteral("ph")] = QStringLiteral("i");
+        } else {
+            object[QStringLiteral("ph")] = QStringLiteral("X");
+            object[QStringLiteral("dur")] = event.duration;
+        }
+        traceEvents.append(object);
+    }
+
+    QJsonObject root;
+    root[QStringLiteral("traceEvents")] = traceEvents;
+    root[QStringLiteral("displayTimeUnit")] = QStringLiteral("ms");
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qCWarning(lcSession, "Failed to write startup trace to \"%s\": %s",
+                  qPrintable(fileName), qPrintable(file.errorString()));
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    file.close();
+
+    return true;
+}
+
+qint64 Timeline::now()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return qint64(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// TimelineScope
+
+TimelineScope::TimelineScope(Timeline *timeline, const QString &name, const QString &category)
+    : m_timeline(timeline)
+    , m_id(timeline->begin(name, category))
+{
+}
+
+TimelineScope::~TimelineScope()
+{
+    m_timeline->end(m_id);
+}
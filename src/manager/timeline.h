@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: 2026 Pier Luigi Fiorini <pierluigi.fiorini@gmail.com>
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <QDBusArgument>
+#include <QDBusMetaType>
+#include <QVector>
+
+class TimelineEvent
+{
+public:
+    QString name;
+    QString category;
+    // Microseconds on the CLOCK_MONOTONIC time base, the same
+    // used by the journal for its monotonic timestamps
+    qint64 start = 0;
+    // Microseconds, -1 while the step is still running
+    qint64 duration = -1;
+};
+Q_DECLARE_METATYPE(TimelineEvent)
+
+typedef QVector<TimelineEvent> TimelineEventList;
+Q_DECLARE_METATYPE(TimelineEventList)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const TimelineEvent &event);
+const QDBusArgument &operator>>(const QDBusArgument &argument, TimelineEvent &event);
+
+class Timeline
+{
+public:
+    Timeline();
+
+    int begin(const QString &name, const QString &category);
+    void end(int id);
+
+    TimelineEventList events() const;
+
+    bool writeChromeTrace(const QString &fileName) const;
+
+    static qint64 now();
+
+private:
+    TimelineEventList m_events;
+};
+
+class TimelineScope
+{
+public:
+    TimelineScope(Timeline *timeline, const QString &name, const QString &category);
+    ~TimelineScope();
+
+private:
+    Timeline *m_timeline = nullptr;
+    int m_id = -1;
+};
+
+#endif // TIMELINE_H
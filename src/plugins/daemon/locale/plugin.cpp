@@ -23,6 +23,7 @@
 
 #include <QDBusConnection>
 #include <QDBusInterface>
+#include <QDBusMetaType>
 
 #include <Qt6GSettings/QGSettings>
 
@@ -34,9 +35,13 @@ const QString regionKey = QStringLiteral("region");
 const QString interfaceName = QStringLiteral("org.freedesktop.locale1");
 const QString objectPath = QStringLiteral("/org/freedesktop/locale1");
 
+typedef QMap<QString, QString> EnvMap;
+
 LocalePlugin::LocalePlugin(QObject *parent)
     : Liri::DaemonModule(parent)
 {
+    qDBusRegisterMetaType<EnvMap>();
+
     getSystemLocale();
 
     m_settings = new QtGSettings::QGSettings(
@@ -57,14 +62,16 @@ void LocalePlugin::stop()
 {
 }
 
-void LocalePlugin::setEnvironment(const QString &key, const QString &value)
+void LocalePlugin::setEnvironment(const EnvMap &environment)
 {
+    // Send all the variables at once, so that the environment
+    // is uploaded only once
     auto msg = QDBusMessage::createMethodCall(
-                QStringLiteral("io.liri.Launcher"),
-                QStringLiteral("/io/liri/Launcher"),
-                QStringLiteral("io.liri.Launcher"),
-                QStringLiteral("SetEnvironment"));
-    msg.setArguments(QVariantList() << key << value);
+                QStringLiteral("io.liri.SessionManager"),
+                QStringLiteral("/io/liri/SessionManager"),
+                QStringLiteral("io.liri.SessionManager"),
+                QStringLiteral("SetEnvironmentBatch"));
+    msg.setArguments(QVariantList() << QVariant::fromValue(environment));
     QDBusConnection::sessionBus().send(msg);
 }
 
@@ -84,29 +91,34 @@ void LocalePlugin::getSystemLocale()
 
 void LocalePlugin::handleSettingChanged(const QString &key)
 {
+    EnvMap environment;
+
     if (key == languageKey) {
         m_language = m_settings->value(languageKey).toString();
         if (m_language.isEmpty())
             m_language = m_systemLocale[QStringLiteral("LANG")];
 
-        setEnvironment(QStringLiteral("LANG"), m_language);
-        setEnvironment(QStringLiteral("LANGUAGE"), m_language);
-        setEnvironment(QStringLiteral("LC_MESSAGES"), m_language);
+        environment[QStringLiteral("LANG")] = m_language;
+        environment[QStringLiteral("LANGUAGE")] = m_language;
+        environment[QStringLiteral("LC_MESSAGES")] = m_language;
     } else if (key == regionKey) {
         m_region = m_settings->value(regionKey).toString();
         if (m_region.isEmpty())
             m_region = m_systemLocale[QStringLiteral("LANG")];
 
-        setEnvironment(QStringLiteral("LC_CTYPE"), m_region);
-        setEnvironment(QStringLiteral("LC_NUMERIC"), m_region);
-        setEnvironment(QStringLiteral("LC_TIME"), m_region);
-        setEnvironment(QStringLiteral("LC_COLLATE"), m_region);
-        setEnvironment(QStringLiteral("LC_MONETARY"), m_region);
-        setEnvironment(QStringLiteral("LC_PAPER"), m_region);
-        setEnvironment(QStringLiteral("LC_NAME"), m_region);
-        setEnvironment(QStringLiteral("LC_ADDRESS"), m_region);
-        setEnvironment(QStringLiteral("LC_TELEPHONE"), m_region);
-        setEnvironment(QStringLiteral("LC_MEASUREMENT"), m_region);
-        setEnvironment(QStringLiteral("LC_IDENTIFICATION"), m_region);
+        environment[QStringLiteral("LC_CTYPE")] = m_region;
+        environment[QStringLiteral("LC_NUMERIC")] = m_region;
+        environment[QStringLiteral("LC_TIME")] = m_region;
+        environment[QStringLiteral("LC_COLLATE")] = m_region;
+        environment[QStringLiteral("LC_MONETARY")] = m_region;
+        environment[QStringLiteral("LC_PAPER")] = m_region;
+        environment[QStringLiteral("LC_NAME")] = m_region;
+        environment[QStringLiteral("LC_ADDRESS")] = m_region;
+        environment[QStringLiteral("LC_TELEPHONE")] = m_region;
+        environment[QStringLiteral("LC_MEASUREMENT")] = m_region;
+        environment[QStringLiteral("LC_IDENTIFICATION")] = m_region;
     }
+
+    if (!environment.isEmpty())
+        setEnvironment(environment);
 }
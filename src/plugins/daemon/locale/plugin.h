@@ -49,9 +49,8 @@ private:
     QString m_language;
     QString m_region;
     QMap<QString, QString> m_systemLocale;
-    QMap<QString, QString> m_env;
 
-    void setEnvironment(const QString &key, const QString &value);
+    void setEnvironment(const QMap<QString, QString> &environment);
     void getSystemLocale();
 
 private Q_SLOTS:
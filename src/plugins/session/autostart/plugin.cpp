@@ -23,16 +23,35 @@
 
 #include <QDBusConnection>
 #include <QDBusMessage>
-#include <QDBusPendingCall>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QStandardPaths>
+#include <QTimer>
 
-#include <LiriXdg/AutoStart>
-#include <LiriXdg/DesktopFile>
+#include <libdesktopentrycache/desktopentrycache.h>
 
 #include "plugin.h"
 
+// How many entries can be starting at the same time,
+// unless overridden by $LIRI_SESSION_AUTOSTART_CONCURRENCY
+static const int defaultMaxStarting = 2;
+
+// Entries that didn't tell us they started after this amount
+// of milliseconds are considered started anyway
+static const int startupTimeout = 10000;
+
+static const QString launcherService = QStringLiteral("io.liri.Launcher");
+static const QString launcherPath = QStringLiteral("/io/liri/Launcher");
+static const QString launcherInterface = QStringLiteral("io.liri.Launcher");
+
 AutostartPlugin::AutostartPlugin(QObject *parent)
-    : Liri::SessionModule(parent)
+    : Liri::AsyncSessionModule(parent)
+    , m_maxStarting(defaultMaxStarting)
 {
+    bool ok = false;
+    const int maxStarting = qEnvironmentVariableIntValue("LIRI_SESSION_AUTOSTART_CONCURRENCY", &ok);
+    if (ok && maxStarting > 0)
+        m_maxStarting = maxStarting;
 }
 
 Liri::SessionModule::StartupPhase AutostartPlugin::startupPhase() const
@@ -40,14 +59,20 @@ Liri::SessionModule::StartupPhase AutostartPlugin::startupPhase() const
     return Applications;
 }
 
-bool AutostartPlugin::start(const QStringList &args)
+void AutostartPlugin::startAsync(const QStringList &args)
 {
     Q_UNUSED(args)
 
-    const auto desktopFileList = Liri::AutoStart::desktopFileList();
-    for (const Liri::DesktopFile &entry : desktopFileList) {
+    // Entries are read from the cache, which is shared with the launcher
+    DesktopEntryCache cache;
+    const auto entries = cache.autostartEntries();
+    for (const auto &entry : entries) {
         // Ignore hidden entries
-        if (!entry.isVisible())
+        if (entry.isHidden())
+            continue;
+
+        // Ignore entries whose program is not installed
+        if (!entry.tryExec().isEmpty() && QStandardPaths::findExecutable(entry.tryExec()).isEmpty())
             continue;
 
         // Ignore entries that are explicitely not meant for Liri
@@ -61,56 +86,194 @@ bool AutostartPlugin::start(const QStringList &args)
         //continue;
 
         // Ignore those entries hidden under systemd
-        if (isSystemdEnabled()) {
-            bool hidden = entry.value(QStringLiteral("X-GNOME-HiddenUnderSystemd")).toString().trimmed().compare(QStringLiteral("true"), Qt::CaseInsensitive);
-            if (hidden)
-                continue;
-        }
+        if (isSystemdEnabled() && entry.isHiddenUnderSystemd())
+            continue;
+
+        Entry autostartEntry;
+        autostartEntry.fileName = entry.fileName();
+        autostartEntry.delay = entry.autostartDelay();
+
+        const auto phase = entry.autostartPhase();
+        if (phase == QLatin1String("Early"))
+            autostartEntry.phase = EarlyPhase;
+        else if (phase == QLatin1String("Late"))
+            autostartEntry.phase = LatePhase;
+        else if (!phase.isEmpty() && phase != QLatin1String("Default"))
+            qCWarning(lcSession, "Unknown autostart phase \"%s\" in \"%s\"",
+                      qPrintable(phase), qPrintable(autostartEntry.fileName));
 
-        qCDebug(lcSession) << "Autostart entry:" << entry.name() << "from" << entry.fileName();
-        m_desktopFiles.append(entry.fileName());
-        launchDesktopFile(entry.fileName());
+        qCDebug(lcSession) << "Autostart entry:" << entry.name() << "from" << entry.fileName()
+                           << "phase" << autostartEntry.phase << "delay" << autostartEntry.delay;
+        m_entries.append(autostartEntry);
     }
 
-    return true;
+    // Entries are launched in the background, the
+    // session doesn't have to wait for them
+    Q_EMIT ready();
+
+    if (m_entries.isEmpty())
+        return;
+
+    // Entries of the same phase keep their order
+    std::stable_sort(m_entries.begin(), m_entries.end(), [](const Entry &a, const Entry &b) {
+        return a.phase < b.phase;
+    });
+
+    QDBusConnection::sessionBus().connect(
+                launcherService, launcherPath, launcherInterface,
+                QStringLiteral("DesktopFileStarted"),
+                this, SLOT(handleDesktopFileStarted(QString)));
+
+    m_context = new QObject(this);
+    m_phase = -1;
+    m_phasePending = 0;
+    beginNextPhase();
 }
 
-bool AutostartPlugin::stop()
+void AutostartPlugin::stopAsync()
 {
-    std::reverse(m_desktopFiles.begin(), m_desktopFiles.end());
+    // Cancel everything that is still to be started
+    delete m_context;
+    m_context = nullptr;
+    m_entries.clear();
+    m_readyEntries.clear();
+    m_startingEntries.clear();
 
-    for (const auto &fileName : qAsConst(m_desktopFiles)) {
-        qCDebug(lcSession) << "Terminate autostart entry from" << fileName;
-        terminateDesktopFile(fileName);
+    QDBusConnection::sessionBus().disconnect(
+                launcherService, launcherPath, launcherInterface,
+                QStringLiteral("DesktopFileStarted"),
+                this, SLOT(handleDesktopFileStarted(QString)));
+
+    if (m_desktopFiles.isEmpty()) {
+        Q_EMIT stopped();
+        return;
     }
 
+    for (const auto &fileName : qAsConst(m_desktopFiles))
+        qCDebug(lcSession) << "Terminate autostart entry from" << fileName;
+    terminateDesktopFiles(m_desktopFiles);
+
     m_desktopFiles.clear();
+}
+
+void AutostartPlugin::beginNextPhase()
+{
+    // Phases with only delayed entries are over as soon as they begin
+    while (m_phasePending == 0 && !m_entries.isEmpty()) {
+        m_phase = m_entries.constFirst().phase;
+        qCDebug(lcSession, "Beginning autostart phase %d", m_phase);
+
+        while (!m_entries.isEmpty() && m_entries.constFirst().phase == m_phase) {
+            const auto entry = m_entries.takeFirst();
 
-    return true;
+            // Delayed entries don't hold back the next phase
+            if (entry.delay > 0) {
+                QTimer::singleShot(entry.delay * 1000, m_context, [this, entry] {
+                    m_readyEntries.append(entry);
+                    admitEntries();
+                });
+            } else {
+                m_readyEntries.append(entry);
+                m_phasePending++;
+            }
+        }
+    }
+
+    admitEntries();
 }
 
-void AutostartPlugin::launchDesktopFile(const QString &fileName)
+void AutostartPlugin::admitEntries()
+{
+    // Launch as many entries as we can with a single call, the next
+    // ones are admitted when these have finished starting
+    QStringList fileNames;
+    while (!m_readyEntries.isEmpty() && m_startingEntries.size() < m_maxStarting) {
+        const auto entry = m_readyEntries.takeFirst();
+        m_startingEntries.insert(entry.fileName, entry);
+        m_desktopFiles.append(entry.fileName);
+        fileNames.append(entry.fileName);
+
+        const auto fileName = entry.fileName;
+        QTimer::singleShot(startupTimeout, m_context, [this, fileName] {
+            handleDesktopFileStarted(fileName);
+        });
+    }
+
+    if (!fileNames.isEmpty())
+        launchDesktopFiles(fileNames);
+}
+
+void AutostartPlugin::launchDesktopFiles(const QStringList &fileNames)
 {
     auto msg = QDBusMessage::createMethodCall(
-                QStringLiteral("io.liri.Launcher"),
-                QStringLiteral("/io/liri/Launcher"),
-                QStringLiteral("io.liri.Launcher"),
-                QStringLiteral("LaunchDesktopFile"));
+                launcherService, launcherPath, launcherInterface,
+                QStringLiteral("LaunchDesktopFiles"));
     QVariantList args;
-    args.append(fileName);
+    args.append(fileNames);
     msg.setArguments(args);
-    QDBusConnection::sessionBus().asyncCall(msg);
+
+    // Results are in the same order of the desktop files
+    auto *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, fileNames](QDBusPendingCallWatcher *self) {
+        QDBusPendingReply<QList<bool>> reply = *self;
+        if (reply.isError()) {
+            qCWarning(lcSession, "Failed to launch autostart entries: %s",
+                      qPrintable(reply.error().message()));
+            for (const auto &fileName : fileNames)
+                handleDesktopFileStarted(fileName);
+        } else {
+            // Don't wait for entries that failed to launch
+            const auto results = reply.value();
+            for (int i = 0; i < results.size() && i < fileNames.size(); ++i) {
+                if (!results.at(i))
+                    handleDesktopFileStarted(fileNames.at(i));
+            }
+        }
+
+        self->deleteLater();
+    });
 }
 
-void AutostartPlugin::terminateDesktopFile(const QString &fileName)
+void AutostartPlugin::terminateDesktopFiles(const QStringList &fileNames)
 {
     auto msg = QDBusMessage::createMethodCall(
-                QStringLiteral("io.liri.Launcher"),
-                QStringLiteral("/io/liri/Launcher"),
-                QStringLiteral("io.liri.Launcher"),
-                QStringLiteral("TerminateDesktopFile"));
+                launcherService, launcherPath, launcherInterface,
+                QStringLiteral("TerminateDesktopFiles"));
     QVariantList args;
-    args.append(fileName);
+    args.append(fileNames);
     msg.setArguments(args);
-    QDBusConnection::sessionBus().asyncCall(msg);
+
+    // The launcher replies when all programs are gone, either
+    // because they quit or because they were killed
+    auto *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *self) {
+        QDBusPendingReply<QList<bool>> reply = *self;
+        if (reply.isError())
+            qCWarning(lcSession, "Failed to terminate autostart entries: %s",
+                      qPrintable(reply.error().message()));
+
+        self->deleteLater();
+        Q_EMIT stopped();
+    });
+}
+
+void AutostartPlugin::handleDesktopFileStarted(const QString &fileName)
+{
+    auto it = m_startingEntries.find(fileName);
+    if (it == m_startingEntries.end())
+        return;
+
+    const auto entry = it.value();
+    m_startingEntries.erase(it);
+
+    if (entry.delay == 0 && entry.phase == m_phase)
+        m_phasePending--;
+
+    qCDebug(lcSession, "Autostart entry \"%s\" started", qPrintable(fileName));
+
+    // Give the slot to the next entry, or move to the next phase
+    if (m_phasePending == 0)
+        beginNextPhase();
+    else
+        admitEntries();
 }
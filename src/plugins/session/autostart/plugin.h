@@ -24,31 +24,64 @@
 #ifndef AUTOSTARTPLUGIN_H
 #define AUTOSTARTPLUGIN_H
 
+#include <QHash>
 #include <QLoggingCategory>
 #include <QObject>
+#include <QVector>
 
 #include <LiriSession/SessionModule>
 
 Q_DECLARE_LOGGING_CATEGORY(lcSession)
 
-class AutostartPlugin : public Liri::SessionModule
+class AutostartPlugin : public Liri::AsyncSessionModule
 {
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID LiriSessionModule_iid FILE "plugin.json")
-    Q_INTERFACES(Liri::SessionModule)
+    Q_PLUGIN_METADATA(IID LiriAsyncSessionModule_iid FILE "plugin.json")
+    Q_INTERFACES(Liri::SessionModule Liri::AsyncSessionModule)
 public:
     explicit AutostartPlugin(QObject *parent = nullptr);
 
     StartupPhase startupPhase() const override;
 
-    bool start(const QStringList &args = QStringList()) override;
-    bool stop() override;
+    void startAsync(const QStringList &args = QStringList()) override;
+    void stopAsync() override;
 
 private:
+    // Order of the entries, from the X-Liri-Autostart-Phase key: they
+    // are all started in the Applications phase of the session, after
+    // the shell, these only tell which ones go first
+    enum Phase {
+        EarlyPhase = 0,
+        DefaultPhase,
+        LatePhase
+    };
+
+    struct Entry {
+        QString fileName;
+        int phase = DefaultPhase;
+        // Seconds to wait once the phase has begun
+        int delay = 0;
+    };
+
+    int m_maxStarting;
+    // Everything that belongs to the current run, such as timers
+    QObject *m_context = nullptr;
+    // Entries whose phase has not begun yet, sorted by phase
+    QVector<Entry> m_entries;
+    int m_phase = -1;
+    // Entries of the current phase that must start before the next phase
+    int m_phasePending = 0;
+    QVector<Entry> m_readyEntries;
+    QHash<QString, Entry> m_startingEntries;
     QStringList m_desktopFiles;
 
-    void launchDesktopFile(const QString &fileName);
-    void terminateDesktopFile(const QString &fileName);
+    void beginNextPhase();
+    void admitEntries();
+    void launchDesktopFiles(const QStringList &fileNames);
+    void terminateDesktopFiles(const QStringList &fileNames);
+
+private Q_SLOTS:
+    void handleDesktopFileStarted(const QString &fileName);
 };
 
 #endif // AUTOSTARTPLUGIN_H
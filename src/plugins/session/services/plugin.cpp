@@ -21,18 +21,53 @@
  * $END_LICENSE$
  ***************************************************************************/
 
-#include <QDBusConnectionInterface>
+#include <QDBusConnection>
 #include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
 #include <QProcessEnvironment>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include <libpidfd/pidfd.h>
 
 #include "plugin.h"
 
-#include <sys/types.h>
+#include <errno.h>
 #include <signal.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// How long services have to quit before they are killed, in milliseconds,
+// unless overridden by $LIRI_SESSION_SERVICES_GRACE_PERIOD
+static const int defaultGracePeriod = 2000;
+
+static const QString busService = QStringLiteral("org.freedesktop.DBus");
+static const QString busPath = QStringLiteral("/org/freedesktop/DBus");
+static const QString busInterface = QStringLiteral("org.freedesktop.DBus");
 
 ServicesPlugin::ServicesPlugin(QObject *parent)
-    : Liri::SessionModule(parent)
+    : Liri::AsyncSessionModule(parent)
+    , m_gracePeriod(defaultGracePeriod)
+{
+    bool ok = false;
+    const int gracePeriod = qEnvironmentVariableIntValue("LIRI_SESSION_SERVICES_GRACE_PERIOD", &ok);
+    if (ok && gracePeriod >= 0)
+        m_gracePeriod = gracePeriod;
+
+    m_gracePeriodTimer = new QTimer(this);
+    m_gracePeriodTimer->setSingleShot(true);
+    connect(m_gracePeriodTimer, &QTimer::timeout,
+            this, &ServicesPlugin::handleGracePeriodTimeout);
+}
+
+ServicesPlugin::~ServicesPlugin()
 {
+    for (auto *service : qAsConst(m_stoppingServices)) {
+        releaseService(service);
+        delete service;
+    }
 }
 
 Liri::SessionModule::StartupPhase ServicesPlugin::startupPhase() const
@@ -40,52 +75,171 @@ Liri::SessionModule::StartupPhase ServicesPlugin::startupPhase() const
     return Daemons;
 }
 
-bool ServicesPlugin::start(const QStringList &args)
+void ServicesPlugin::startAsync(const QStringList &args)
 {
     Q_UNUSED(args)
 
+    // Ready once the service is up, meanwhile other modules are started
+    m_context = new QObject(this);
     startService(QStringLiteral("io.liri.Daemon"));
+}
 
-    return true;
+void ServicesPlugin::stopAsync()
+{
+    // Forget about a service that is still starting
+    delete m_context;
+    m_context = nullptr;
+
+    // Ask all services to quit at the same time
+    std::reverse(m_services.begin(), m_services.end());
+    for (const auto &service : qAsConst(m_services)) {
+        auto *stoppingService = new Service(service);
+        stoppingService->elapsedTimer.start();
+
+        // Services are not our children, but a pidfd becomes
+        // readable when the process exits anyway
+        stoppingService->pidfd = Pidfd::open(static_cast<pid_t>(service.pid));
+        if (stoppingService->pidfd < 0) {
+            if (errno == ESRCH) {
+                qCInfo(lcSession, "Service \"%s\" (pid %u) has already exited",
+                       qPrintable(service.name), service.pid);
+                delete stoppingService;
+                continue;
+            }
+
+            qCWarning(lcSession, "Cannot watch service \"%s\" (pid %u): %s",
+                      qPrintable(service.name), service.pid, strerror(errno));
+        } else {
+            stoppingService->notifier =
+                    new QSocketNotifier(stoppingService->pidfd, QSocketNotifier::Read, this);
+            connect(stoppingService->notifier, &QSocketNotifier::activated, this, [this, stoppingService] {
+                handleServiceExited(stoppingService);
+            });
+        }
+
+        if (!sendSignal(stoppingService, SIGTERM)) {
+            releaseService(stoppingService);
+            delete stoppingService;
+            continue;
+        }
+
+        m_stoppingServices.append(stoppingService);
+    }
+
+    m_services.clear();
+
+    if (m_stoppingServices.isEmpty()) {
+        Q_EMIT stopped();
+        return;
+    }
+
+    // Kill the services that don't quit in time
+    m_gracePeriodTimer->start(m_gracePeriod);
 }
 
-bool ServicesPlugin::stop()
+void ServicesPlugin::startService(const QString &name)
 {
-    std::reverse(m_pids.begin(), m_pids.end());
+    // The bus replies right away if the service is already running
+    auto msg = QDBusMessage::createMethodCall(
+                busService, busPath, busInterface,
+                QStringLiteral("StartServiceByName"));
+    msg << name << uint(0);
+
+    auto *watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), m_context);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, name](QDBusPendingCallWatcher *self) {
+        self->deleteLater();
+
+        QDBusPendingReply<uint> reply = *self;
+        if (reply.isError()) {
+            qCWarning(lcSession, "Failed to start \"%s\" D-Bus service: %s",
+                      qPrintable(name), qPrintable(reply.error().message()));
+            Q_EMIT ready();
+            return;
+        }
+
+        // The pid is needed to stop it
+        auto msg = QDBusMessage::createMethodCall(
+                    busService, busPath, busInterface,
+                    QStringLiteral("GetConnectionUnixProcessID"));
+        msg << name;
+
+        auto *pidWatcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), m_context);
+        connect(pidWatcher, &QDBusPendingCallWatcher::finished, this, [this, name](QDBusPendingCallWatcher *self) {
+            self->deleteLater();
 
-    auto i = m_pids.begin();
-    while (i != m_pids.end()) {
-        uint pid = (*i);
-        ::kill(pid, SIGTERM);
-        ::kill(pid, SIGKILL);
+            QDBusPendingReply<uint> reply = *self;
+            if (reply.isValid())
+                m_services.append(Service{name, reply.value()});
+            else
+                qCWarning(lcSession, "Cannot get the pid of \"%s\" D-Bus service: %s",
+                          qPrintable(name), qPrintable(reply.error().message()));
 
-        i = m_pids.erase(i);
+            Q_EMIT ready();
+        });
+    });
+}
+
+bool ServicesPlugin::sendSignal(Service *service, int signum)
+{
+    // Signals sent through a pidfd can't reach a recycled pid
+    const int result = service->pidfd >= 0
+            ? Pidfd::sendSignal(service->pidfd, signum)
+            : ::kill(static_cast<pid_t>(service->pid), signum);
+    if (result < 0) {
+        if (errno != ESRCH)
+            qCWarning(lcSession, "Failed to send signal %d to service \"%s\" (pid %u): %s",
+                      signum, qPrintable(service->name), service->pid, strerror(errno));
+        return false;
     }
 
     return true;
 }
 
-void ServicesPlugin::startService(const QString &name)
+void ServicesPlugin::handleServiceExited(Service *service)
 {
-    auto interface = QDBusConnection::sessionBus().interface();
-
-    // Check if the service is already registered
-    auto existsReply = interface->isServiceRegistered(name);
-    if (existsReply.isValid() && existsReply.value()) {
-        auto pidReply = interface->servicePid(name);
-        if (pidReply.isValid())
-            m_pids.append(pidReply.value());
-        return;
+    qCInfo(lcSession, "Service \"%s\" (pid %u) exited in %lld ms",
+           qPrintable(service->name), service->pid, service->elapsedTimer.elapsed());
+
+    m_stoppingServices.removeOne(service);
+    releaseService(service);
+    delete service;
+
+    if (m_stoppingServices.isEmpty()) {
+        m_gracePeriodTimer->stop();
+        Q_EMIT stopped();
+    }
+}
+
+void ServicesPlugin::handleGracePeriodTimeout()
+{
+    const auto services = m_stoppingServices;
+    for (auto *service : services) {
+        qCWarning(lcSession, "Service \"%s\" (pid %u) didn't quit within %d ms, killing it",
+                  qPrintable(service->name), service->pid, m_gracePeriod);
+
+        // Without a pidfd we can't know when it's gone,
+        // and SIGKILL can't be ignored anyway
+        if (!sendSignal(service, SIGKILL) || service->pidfd < 0) {
+            m_stoppingServices.removeOne(service);
+            releaseService(service);
+            delete service;
+        }
+    }
+
+    if (m_stoppingServices.isEmpty())
+        Q_EMIT stopped();
+}
+
+void ServicesPlugin::releaseService(Service *service)
+{
+    if (service->notifier) {
+        service->notifier->setEnabled(false);
+        service->notifier->deleteLater();
+        service->notifier = nullptr;
     }
 
-    // If not, start the service
-    auto reply = interface->startService(name);
-    if (reply.isValid()) {
-        auto pidReply = interface->servicePid(name);
-        if (pidReply.isValid())
-            m_pids.append(pidReply.value());
-    } else {
-        qCWarning(lcSession, "Failed to start \"%s\" D-Bus service: %s",
-                  qPrintable(name), qPrintable(reply.error().message()));
+    if (service->pidfd >= 0) {
+        ::close(service->pidfd);
+        service->pidfd = -1;
     }
 }
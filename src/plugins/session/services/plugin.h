@@ -24,6 +24,7 @@
 #ifndef SERVICESPLUGIN_H
 #define SERVICESPLUGIN_H
 
+#include <QElapsedTimer>
 #include <QLoggingCategory>
 #include <QObject>
 
@@ -31,23 +32,44 @@
 
 Q_DECLARE_LOGGING_CATEGORY(lcSession)
 
-class ServicesPlugin : public Liri::SessionModule
+class QSocketNotifier;
+class QTimer;
+
+class ServicesPlugin : public Liri::AsyncSessionModule
 {
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID LiriSessionModule_iid FILE "plugin.json")
-    Q_INTERFACES(Liri::SessionModule)
+    Q_PLUGIN_METADATA(IID LiriAsyncSessionModule_iid FILE "plugin.json")
+    Q_INTERFACES(Liri::SessionModule Liri::AsyncSessionModule)
 public:
     explicit ServicesPlugin(QObject *parent = nullptr);
+    ~ServicesPlugin();
 
     StartupPhase startupPhase() const override;
 
-    bool start(const QStringList &args = QStringList()) override;
-    bool stop() override;
+    void startAsync(const QStringList &args = QStringList()) override;
+    void stopAsync() override;
 
 private:
-    QVector<uint> m_pids;
+    struct Service {
+        QString name;
+        uint pid = 0;
+        int pidfd = -1;
+        QSocketNotifier *notifier = nullptr;
+        QElapsedTimer elapsedTimer;
+    };
+
+    // Everything that belongs to the current run, such as pending calls
+    QObject *m_context = nullptr;
+    QVector<Service> m_services;
+    QVector<Service *> m_stoppingServices;
+    QTimer *m_gracePeriodTimer = nullptr;
+    int m_gracePeriod;
 
     void startService(const QString &name);
+    bool sendSignal(Service *service, int signum);
+    void handleServiceExited(Service *service);
+    void handleGracePeriodTimeout();
+    void releaseService(Service *service);
 };
 
 #endif // SERVICESPLUGIN_H
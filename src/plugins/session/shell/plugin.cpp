@@ -21,20 +21,51 @@
  * $END_LICENSE$
  ***************************************************************************/
 
+#include <QCoreApplication>
 #include <QDBusConnection>
 #include <QDBusServiceWatcher>
-#include <QEventLoop>
 #include <QFile>
+#include <QSocketNotifier>
 #include <QTimer>
 
+#include <libjournalstream/journalstream.h>
+
 #include "plugin.h"
 
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
 const QString shellServiceName = QStringLiteral("io.liri.Shell");
 
+// How long to wait for the shell to be ready, in milliseconds
+const int readyTimeout = 30 * 1000;
+
+// Attempts to run the shell each time it's started
+const int maxRetries = 5;
+
+// How long to wait for the shell to quit before killing it, in milliseconds;
+// this is shorter than the default stop deadline of the session manager
+const int killTimeout = 3 * 1000;
+
 ShellPlugin::ShellPlugin(QObject *parent)
-    : Liri::SessionModule(parent)
+    : Liri::AsyncSessionModule(parent)
 {
-    m_loop = new QEventLoop(this);
+    m_readyTimer = new QTimer(this);
+    m_readyTimer->setSingleShot(true);
+    m_readyTimer->setInterval(readyTimeout);
+    connect(m_readyTimer, &QTimer::timeout,
+            this, &ShellPlugin::handleReadyTimeout);
+
+    m_killTimer = new QTimer(this);
+    m_killTimer->setSingleShot(true);
+    m_killTimer->setInterval(killTimeout);
+    connect(m_killTimer, &QTimer::timeout,
+            this, &ShellPlugin::handleKillTimeout);
 
     m_serviceWatcher =
             new QDBusServiceWatcher(shellServiceName, QDBusConnection::sessionBus(),
@@ -50,29 +81,32 @@ ShellPlugin::ShellPlugin(QObject *parent)
     m_serverProcess->setProcessChannelMode(QProcess::ForwardedChannels);
     m_serverProcess->setProgram(QString::asprintf("%s/liri-shell", LIBEXECDIR));
 
-    connect(m_serverProcess, &QProcess::readyReadStandardOutput,
-            this, &ShellPlugin::handleStandardOutput);
-    connect(m_serverProcess, &QProcess::readyReadStandardError,
-            this, &ShellPlugin::handleStandardError);
+    connect(m_serverProcess, &QProcess::started,
+            this, &ShellPlugin::processStarted);
     connect(m_serverProcess, &QProcess::errorOccurred,
             this, &ShellPlugin::processCrashed);
     connect(m_serverProcess, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
             this, &ShellPlugin::processFinished);
 }
 
+ShellPlugin::~ShellPlugin()
+{
+    closeNotifySocket();
+}
+
 Liri::SessionModule::StartupPhase ShellPlugin::startupPhase() const
 {
     return WindowManager;
 }
 
-bool ShellPlugin::start(const QStringList &args)
+void ShellPlugin::startAsync(const QStringList &args)
 {
     // Save the effort of running it, if the executable doesn't exist
     if (!QFile::exists(m_serverProcess->program())) {
-        qCWarning(lcSession, "Couldn't find the \"%s\" executable, "
-                             "please check your installation",
-                  qPrintable(m_serverProcess->program()));
-        return false;
+        Q_EMIT failed(QStringLiteral("Couldn't find the \"%1\" executable, "
+                                     "please check your installation")
+                      .arg(m_serverProcess->program()));
+        return;
     }
 
     // Set arguments
@@ -82,47 +116,223 @@ bool ShellPlugin::start(const QStringList &args)
     QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
     env.remove(QStringLiteral("QT_QPA_PLATFORM"));
     env.remove(QStringLiteral("QT_WAYLAND_SHELL_INTEGRATION"));
+
+    // The shell notifies when it's ready using the sd_notify() protocol,
+    // if the socket can't be created we rely only on the D-Bus service
+    // to be registered
+    if (createNotifySocket())
+        env.insert(QStringLiteral("NOTIFY_SOCKET"), QLatin1Char('@') + m_notifySocketName);
+    else
+        env.remove(QStringLiteral("NOTIFY_SOCKET"));
+
     m_serverProcess->setProcessEnvironment(env);
 
-    // Run with retries
-    int retries = 5;
-    while (retries-- > 0) {
-        qCWarning(lcSession, "Trying to run liri-shell...");
-        m_serverProcess->start();
-        if (m_serverProcess->waitForStarted()) {
-            // The process has started, but we can't continue until the D-Bus
-            // service is up, that is when the shell is really up and running
-            QTimer::singleShot(30 * 1000, m_loop, &QEventLoop::quit);
-            m_loop->exec();
-            return m_serverProcess->state() == QProcess::Running;
-        } else {
-            if (retries == 0)
-                qCWarning(lcSession, "Failed to start liri-shell, giving up!");
-            else
-                qCWarning(lcSession,
-                          "Failed to start liri-shell, %d attempt(s) left",
-                          retries);
-        }
+    // Run, ready() or failed() will be emitted later
+    qCInfo(lcSession, "Trying to run liri-shell...");
+    m_elapsedTimer.start();
+    setReadinessState(Starting);
+    m_retries = maxRetries;
+    startProcess();
+}
+
+void ShellPlugin::stopAsync()
+{
+    m_stopping = true;
+
+    m_readyTimer->stop();
+    closeNotifySocket();
+
+    if (m_serverProcess->state() == QProcess::NotRunning) {
+        setReadinessState(NotRunning);
+        m_stopping = false;
+        Q_EMIT stopped();
+        return;
     }
 
-    return false;
+    // Kill the shell if it doesn't quit in time, stopped() is emitted
+    // when the process is finished
+    m_serverProcess->terminate();
+    m_killTimer->start();
 }
 
-bool ShellPlugin::stop()
+void ShellPlugin::setReadinessState(ReadinessState state)
 {
-    m_stopping = true;
+    if (m_state == state)
+        return;
+
+    m_state = state;
+
+    Q_EMIT readinessStateChanged(m_state);
+
+    switch (m_state) {
+    case WaitingForReady:
+        m_readyTimer->start();
+        break;
+    case Ready:
+        qCInfo(lcSession, "Shell is ready after %lld ms", m_elapsedTimer.elapsed());
+        m_readyTimer->stop();
+        closeNotifySocket();
+        Q_EMIT ready();
+        break;
+    case Failed:
+        m_readyTimer->stop();
+        closeNotifySocket();
+
+        // Can't continue without the display server
+        if (!m_stopping)
+            Q_EMIT failed(QStringLiteral("liri-shell did not start"));
+        break;
+    default:
+        break;
+    }
+}
+
+bool ShellPlugin::createNotifySocket()
+{
+    closeNotifySocket();
+
+    m_notifyFd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (m_notifyFd < 0) {
+        qCWarning(lcSession, "Failed to create notification socket: %s",
+                  strerror(errno));
+        return false;
+    }
+
+    // Anyone can send to an abstract socket, credentials tell us
+    // whether messages come from the shell
+    const int enable = 1;
+    if (::setsockopt(m_notifyFd, SOL_SOCKET, SO_PASSCRED, &enable, sizeof(enable)) < 0) {
+        qCWarning(lcSession, "Failed to enable credentials on notification socket: %s",
+                  strerror(errno));
+        closeNotifySocket();
+        return false;
+    }
 
-    if (m_serverProcess) {
-        m_serverProcess->terminate();
-        if (!m_serverProcess->waitForFinished())
-            m_serverProcess->kill();
+    m_notifySocketName =
+            QStringLiteral("liri-session-shell-%1").arg(QCoreApplication::applicationPid());
+    const QByteArray name = m_notifySocketName.toLocal8Bit();
+
+    // Bind to an abstract socket address, which starts with a NUL byte
+    // and doesn't leave anything behind on the file system
+    struct sockaddr_un address;
+    ::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (size_t(name.size()) + 1 > sizeof(address.sun_path)) {
+        closeNotifySocket();
+        return false;
+    }
+    ::memcpy(address.sun_path + 1, name.constData(), name.size());
+    const socklen_t length = offsetof(struct sockaddr_un, sun_path) + 1 + name.size();
+
+    if (::bind(m_notifyFd, reinterpret_cast<struct sockaddr *>(&address), length) < 0) {
+        qCWarning(lcSession, "Failed to bind notification socket: %s",
+                  strerror(errno));
+        closeNotifySocket();
+        return false;
     }
 
-    m_stopping = false;
+    m_notifier = new QSocketNotifier(m_notifyFd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated,
+            this, &ShellPlugin::handleNotifyMessage);
 
     return true;
 }
 
+void ShellPlugin::closeNotifySocket()
+{
+    if (m_notifier) {
+        m_notifier->setEnabled(false);
+        m_notifier->deleteLater();
+        m_notifier = nullptr;
+    }
+
+    if (m_notifyFd >= 0) {
+        ::close(m_notifyFd);
+        m_notifyFd = -1;
+    }
+}
+
+void ShellPlugin::handleNotifyMessage()
+{
+    char buffer[4096];
+
+    forever {
+        struct iovec iov;
+        iov.iov_base = buffer;
+        iov.iov_len = sizeof(buffer);
+
+        // Room for credentials only, file descriptors are discarded
+        union {
+            struct cmsghdr header;
+            char data[CMSG_SPACE(sizeof(struct ucred))];
+        } control;
+
+        struct msghdr message;
+        ::memset(&message, 0, sizeof(message));
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = &control;
+        message.msg_controllen = sizeof(control);
+
+        const ssize_t size = ::recvmsg(m_notifyFd, &message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (size < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        const struct ucred *credentials = nullptr;
+        for (auto *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_CREDENTIALS &&
+                    header->cmsg_len == CMSG_LEN(sizeof(struct ucred)))
+                credentials = reinterpret_cast<const struct ucred *>(CMSG_DATA(header));
+        }
+        if (!credentials || credentials->pid != m_serverProcess->processId()) {
+            qCWarning(lcSession, "Ignoring notification from process %d, it's not the shell",
+                      credentials ? int(credentials->pid) : -1);
+            continue;
+        }
+
+        // A datagram contains newline separated assignments
+        const auto lines = QByteArray(buffer, size).split('\n');
+        for (const auto &line : lines) {
+            if (line == "READY=1") {
+                if (m_state == WaitingForReady)
+                    setReadinessState(Ready);
+            } else if (line.startsWith("STATUS=")) {
+                qCInfo(lcSession, "Shell status: %s", line.mid(7).constData());
+            }
+        }
+
+        // The socket is closed once the shell is ready
+        if (m_notifyFd < 0)
+            break;
+    }
+}
+
+void ShellPlugin::handleReadyTimeout()
+{
+    // Keep going if the shell is running, even though it didn't
+    // tell us that it's ready
+    if (m_serverProcess->state() == QProcess::Running) {
+        qCWarning(lcSession, "Shell didn't signal readiness within %d seconds, "
+                             "assuming it's ready",
+                  readyTimeout / 1000);
+        setReadinessState(Ready);
+    } else {
+        setReadinessState(Failed);
+    }
+}
+
+void ShellPlugin::handleKillTimeout()
+{
+    if (m_serverProcess->state() != QProcess::NotRunning) {
+        qCWarning(lcSession, "liri-shell didn't quit within %d seconds, killing it",
+                  killTimeout / 1000);
+        m_serverProcess->kill();
+    }
+}
+
 void ShellPlugin::handleServiceRegistered(const QString &serviceName)
 {
     if (serviceName == shellServiceName) {
@@ -131,8 +341,9 @@ void ShellPlugin::handleServiceRegistered(const QString &serviceName)
                    this, &ShellPlugin::handleServiceRegistered);
 
         // The shell D-Bus service is registered, this means it's ready
-        // and we can move on to the next session module
-        m_loop->quit();
+        // even if it didn't use the notification socket
+        if (m_state == WaitingForReady)
+            setReadinessState(Ready);
     }
 }
 
@@ -148,18 +359,37 @@ void ShellPlugin::handleServiceUnregistered(const QString &serviceName)
     }
 }
 
-void ShellPlugin::handleStandardOutput()
+void ShellPlugin::startProcess()
 {
-    auto *process = qobject_cast<QProcess *>(sender());
-    if (process)
-        qInfo() << process->readAllStandardOutput();
+    // The shell writes to the journal directly, when possible,
+    // otherwise its output goes where ours goes
+    const int stdoutFd = JournalStream::open(QStringLiteral("liri-shell"), JournalStream::Info);
+    const int stderrFd = JournalStream::open(QStringLiteral("liri-shell"), JournalStream::Warning);
+    m_serverProcess->setChildProcessModifier([stdoutFd, stderrFd] {
+        if (stdoutFd >= 0)
+            ::dup2(stdoutFd, STDOUT_FILENO);
+        if (stderrFd >= 0)
+            ::dup2(stderrFd, STDERR_FILENO);
+    });
+
+    m_serverProcess->start();
+
+    // The child has its own copies by now
+    if (stdoutFd >= 0)
+        ::close(stdoutFd);
+    if (stderrFd >= 0)
+        ::close(stderrFd);
 }
 
-void ShellPlugin::handleStandardError()
+void ShellPlugin::processStarted()
 {
-    auto *process = qobject_cast<QProcess *>(sender());
-    if (process)
-        qCritical() << process->readAllStandardError();
+    // Restarts after a crash get all their attempts again
+    m_retries = maxRetries;
+
+    // The process has started, but we can't continue until it
+    // tells us it's ready or the D-Bus service is up
+    if (m_state == Starting)
+        setReadinessState(WaitingForReady);
 }
 
 void ShellPlugin::processCrashed(QProcess::ProcessError error)
@@ -169,15 +399,30 @@ void ShellPlugin::processCrashed(QProcess::ProcessError error)
         qCWarning(lcSession,
                   "Failed to start \"%s\": check if liri-shell is installed correctly",
                   qPrintable(m_serverProcess->program()));
-        m_loop->quit();
+        if (m_state == Starting) {
+            if (--m_retries > 0) {
+                qCWarning(lcSession,
+                          "Failed to start liri-shell, %d attempt(s) left",
+                          m_retries);
+                startProcess();
+            } else {
+                qCWarning(lcSession, "Failed to start liri-shell, giving up!");
+                setReadinessState(Failed);
+            }
+        }
         break;
     case QProcess::Crashed:
         qCWarning(lcSession,
                   "Program \"%s\" just crashed", qPrintable(m_serverProcess->program()));
-        m_loop->quit();
         if (m_serverProcess->state() == QProcess::NotRunning && !m_stopping) {
-            if (m_watchDogCounter-- > 0)
-                m_serverProcess->start();
+            if (m_watchDogCounter-- > 0) {
+                // Wait for readiness again if it crashed during startup
+                if (m_state == WaitingForReady)
+                    setReadinessState(Starting);
+                startProcess();
+            } else if (m_state != Ready) {
+                setReadinessState(Failed);
+            }
         }
         break;
     case QProcess::UnknownError:
@@ -195,4 +440,16 @@ void ShellPlugin::processFinished(int exitCode, QProcess::ExitStatus exitStatus)
         qCWarning(lcSession,
                   "\"%s\" finished with exit code %d",
                   qPrintable(m_serverProcess->program()), exitCode);
+
+    // Exiting before being ready is a failure
+    if (exitStatus == QProcess::NormalExit && m_state == WaitingForReady && !m_stopping)
+        setReadinessState(Failed);
+
+    // We were waiting for the process to finish in order to stop
+    if (m_stopping) {
+        m_killTimer->stop();
+        setReadinessState(NotRunning);
+        m_stopping = false;
+        Q_EMIT stopped();
+    }
 }
@@ -24,6 +24,7 @@
 #ifndef SHELLPLUGIN_H
 #define SHELLPLUGIN_H
 
+#include <QElapsedTimer>
 #include <QLoggingCategory>
 #include <QProcess>
 
@@ -32,33 +33,61 @@
 Q_DECLARE_LOGGING_CATEGORY(lcSession)
 
 class QDBusServiceWatcher;
-class QEventLoop;
+class QSocketNotifier;
+class QTimer;
 
-class ShellPlugin : public Liri::SessionModule
+class ShellPlugin : public Liri::AsyncSessionModule
 {
     Q_OBJECT
-    Q_PLUGIN_METADATA(IID LiriSessionModule_iid FILE "plugin.json")
-    Q_INTERFACES(Liri::SessionModule)
+    Q_PLUGIN_METADATA(IID LiriAsyncSessionModule_iid FILE "plugin.json")
+    Q_INTERFACES(Liri::SessionModule Liri::AsyncSessionModule)
 public:
+    enum ReadinessState {
+        NotRunning,
+        Starting,
+        WaitingForReady,
+        Ready,
+        Failed
+    };
+    Q_ENUM(ReadinessState)
+
     explicit ShellPlugin(QObject *parent = nullptr);
+    ~ShellPlugin();
 
     StartupPhase startupPhase() const override;
 
-    bool start(const QStringList &args = QStringList()) override;
-    bool stop() override;
+    void startAsync(const QStringList &args = QStringList()) override;
+    void stopAsync() override;
+
+Q_SIGNALS:
+    void readinessStateChanged(ReadinessState state);
 
 private:
+    ReadinessState m_state = NotRunning;
+    int m_retries = 0;
     int m_watchDogCounter = 3;
-    QEventLoop *m_loop = nullptr;
+    int m_notifyFd = -1;
+    QString m_notifySocketName;
+    QSocketNotifier *m_notifier = nullptr;
+    QTimer *m_readyTimer = nullptr;
+    QTimer *m_killTimer = nullptr;
+    QElapsedTimer m_elapsedTimer;
     QDBusServiceWatcher *m_serviceWatcher = nullptr;
     QProcess *m_serverProcess = nullptr;
     bool m_stopping = false;
 
+    void setReadinessState(ReadinessState state);
+    bool createNotifySocket();
+    void closeNotifySocket();
+    void startProcess();
+
 private Q_SLOTS:
+    void handleNotifyMessage();
+    void handleReadyTimeout();
+    void handleKillTimeout();
     void handleServiceRegistered(const QString &serviceName);
     void handleServiceUnregistered(const QString &serviceName);
-    void handleStandardOutput();
-    void handleStandardError();
+    void processStarted();
     void processCrashed(QProcess::ProcessError error);
     void processFinished(int exitCode, QProcess::ExitStatus exitStatus);
 };